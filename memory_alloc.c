@@ -3,264 +3,2537 @@
 #include <assert.h>
 #include <math.h>
 #include <setjmp.h>
+#include <string.h>
+#include <time.h>
 #include "cmocka.h"
 #include "memory_alloc.h"
 
 struct memory_alloc_t m;
 
-/* Initialize the memory allocator */
-void memory_init() {
-  m.available_blocks = DEFAULT_SIZE;
-  m.first_block = 0;
-  int i;
-  for (i = 0; i < DEFAULT_SIZE-1; i++)
-  {
-    m.blocks[i] = i+1;
+/*************************************************/
+/*                    Bitmaps                    */
+/*************************************************/
+
+/* Release the words of a bitmap */
+static void bitmap_destroy(struct memory_bitmap *map) {
+  for(int level = 0; level < map->nb_levels; level++) {
+    free(map->words[level]);
+    map->words[level] = NULL;
+  }
+  map->nb_levels = 0;
+}
+
+/* Allocate a bitmap of nb_bits cleared bits. Return -1 on failure */
+static int bitmap_init(struct memory_bitmap *map, size_t nb_bits) {
+  size_t bits = nb_bits;
+  map->nb_levels = 0;
+  do {
+    size_t nb_words = (bits + 63) / 64;
+    // one more word so that looking at the word after the last bit is safe
+    map->words[map->nb_levels] = calloc(nb_words + 1, sizeof(uint64_t));
+    map->nb_bits[map->nb_levels] = bits;
+    map->nb_levels++;
+    if(map->words[map->nb_levels-1] == NULL) {
+      bitmap_destroy(map);
+      return -1;
+    }
+    bits = nb_words;
+  } while(bits > 1);
+  return 0;
+}
+
+/* Return the bit i of the bitmap */
+static int bitmap_get(const struct memory_bitmap *map, size_t i) {
+  return (map->words[0][i >> 6] >> (i & 63)) & 1;
+}
+
+/* Report a change of the word w of level to the upper levels */
+static void bitmap_propagate(struct memory_bitmap *map, int level, size_t w) {
+  for(; level+1 < map->nb_levels; level++) {
+    uint64_t *parent = &map->words[level+1][w >> 6];
+    uint64_t old = *parent;
+    if(map->words[level][w]) {
+      *parent |= 1ULL << (w & 63);
+    }else{
+      *parent &= ~(1ULL << (w & 63));
+    }
+    if(*parent == old) { return; } // nothing changes above
+    w >>= 6;
+  }
+}
+
+/* Set (value != 0) or clear (value == 0) the nb bits starting at start */
+static void bitmap_assign(struct memory_bitmap *map, size_t start, size_t nb, int value) {
+  size_t end = start + nb;
+  while(start < end) {
+    size_t w = start >> 6;
+    size_t last = end < (w+1)*64 ? end : (w+1)*64;
+    uint64_t mask = last - start == 64 ? ~0ULL : ((1ULL << (last - start)) - 1) << (start & 63);
+    if(value) {
+      map->words[0][w] |= mask;
+    }else{
+      map->words[0][w] &= ~mask;
+    }
+    bitmap_propagate(map, 0, w);
+    start = last;
+  }
+}
+
+/* Return the highest set bit below i, NULL_BLOCK if there is none */
+static int bitmap_prev(const struct memory_bitmap *map, size_t i) {
+  int level = 0;
+  size_t pos = i;
+  for(;;) {
+    if(level == map->nb_levels) { return NULL_BLOCK; }
+    uint64_t mask = (pos & 63) ? ~0ULL >> (64 - (pos & 63)) : 0;
+    uint64_t bits = map->words[level][pos >> 6] & mask;
+    if(bits) {
+      pos = (pos & ~(size_t)63) + 63 - __builtin_clzll(bits);
+      break;
+    }
+    pos >>= 6; // look at the words before this one in the upper level
+    level++;
+  }
+  while(level > 0) {
+    level--;
+    pos = pos*64 + 63 - __builtin_clzll(map->words[level][pos]);
+  }
+  return pos;
+}
+
+/* Return the lowest set bit from i, NULL_BLOCK if there is none */
+static int bitmap_next(const struct memory_bitmap *map, size_t i) {
+  int level = 0;
+  size_t pos = i;
+  for(;;) {
+    if(level == map->nb_levels || pos >= map->nb_bits[level]) { return NULL_BLOCK; }
+    uint64_t bits = map->words[level][pos >> 6] & (~0ULL << (pos & 63));
+    if(bits) {
+      pos = (pos & ~(size_t)63) + __builtin_ctzll(bits);
+      break;
+    }
+    pos = (pos >> 6) + 1; // look at the words after this one in the upper level
+    level++;
+  }
+  while(level > 0) {
+    level--;
+    pos = pos*64 + __builtin_ctzll(map->words[level][pos]);
+  }
+  return pos;
+}
+
+/* Return the number of set bits */
+static size_t bitmap_count(const struct memory_bitmap *map) {
+  size_t count = 0;
+  for(size_t w = 0; w < (map->nb_bits[0] + 63) / 64; w++) {
+    count += __builtin_popcountll(map->words[0][w]);
+  }
+  return count;
+}
+
+/* Return the lowest cleared bit from i, the number of bits if there is none */
+static size_t bitmap_next_clear(const struct memory_bitmap *map, size_t i) {
+  size_t w = i >> 6;
+  uint64_t bits = ~map->words[0][w] & (~0ULL << (i & 63));
+  while(bits == 0) { // the word after the last bit is zero, so this ends
+    w++;
+    bits = ~map->words[0][w];
+  }
+  size_t pos = w*64 + __builtin_ctzll(bits);
+  return pos < map->nb_bits[0] ? pos : map->nb_bits[0];
+}
+
+/* Return the first bit of the run of set bits ending right before i (i
+ * if bit i-1 is cleared)
+ */
+static size_t bitmap_run_start(const struct memory_bitmap *map, size_t i) {
+  if(i == 0) { return 0; }
+  size_t w = (i-1) >> 6;
+  uint64_t bits = ~map->words[0][w] & (~0ULL >> (63 - ((i-1) & 63)));
+  while(bits == 0) {
+    if(w == 0) { return 0; }
+    w--;
+    bits = ~map->words[0][w];
+  }
+  return w*64 + 64 - __builtin_clzll(bits);
+}
+
+/* Return the first bit of the lowest run of nb set bits, NULL_BLOCK if
+ * there is none. Runs are walked a word at a time: the upper levels skip
+ * the cleared words and a set word covers 64 bits at once.
+ */
+static int bitmap_find_run(const struct memory_bitmap *map, size_t nb) {
+  int start = bitmap_next(map, 0);
+  while(start != NULL_BLOCK) {
+    size_t end = bitmap_next_clear(map, start);
+    if(end - start >= nb) {
+      return start;
+    }
+    start = bitmap_next(map, end);
+  }
+  return NULL_BLOCK;
+}
+
+/*************************************************/
+/*                Memory allocator               */
+/*************************************************/
+
+/* Return the size class of an extent of len blocks: one class per
+ * length up to MEMORY_EXACT_CLASSES blocks, then one class per power of two
+ */
+static int size_class(size_t len) {
+  if(len <= MEMORY_EXACT_CLASSES) {
+    return len - 1;
+  }
+  return MEMORY_EXACT_CLASSES + (63 - __builtin_clzll(len)) - __builtin_ctz(MEMORY_EXACT_CLASSES);
+}
+
+/* Set the boundary tags of the extent of len blocks starting at head
+ * and push it on the free list *list
+ */
+static void free_list_push(struct memory_alloc_t *ctx, int *list, int head, size_t len) {
+  ctx->extent_len[head] = len;
+  ctx->extent_len[head + len - 1] = len;
+  ctx->class_prev[head] = NULL_BLOCK;
+  ctx->class_next[head] = *list;
+  if(*list != NULL_BLOCK) {
+    ctx->class_prev[*list] = head;
+  }
+  *list = head;
+}
+
+/* Unlink the extent starting at head from the free list *list.
+ * Return non-zero if the list is now empty.
+ */
+static int free_list_unlink(struct memory_alloc_t *ctx, int *list, int head) {
+  int prev = ctx->class_prev[head];
+  int next = ctx->class_next[head];
+  if(prev == NULL_BLOCK) {
+    *list = next;
+  }else{
+    ctx->class_next[prev] = next;
+  }
+  if(next != NULL_BLOCK) {
+    ctx->class_prev[next] = prev;
+  }
+  return *list == NULL_BLOCK;
+}
+
+/* placement policy of ctx. Fixed at build time when MEMORY_POLICY is
+ * defined, so that the compiler calls its functions directly.
+ */
+#ifdef MEMORY_POLICY
+#define POLICY(ctx) (&MEMORY_POLICY)
+#else
+#define POLICY(ctx) ((ctx)->policy)
+#endif
+
+/* flag set in the header of the lifelike areas handed out by the thread
+ * caches. These areas are not in header_map, so that memory_ctx_pack()
+ * never moves an area that a cache refers to.
+ */
+#define MEMORY_CACHED 1
+
+#ifdef MEMORY_THREAD_SAFE
+/* number of heap locks held by the calling thread */
+static _Thread_local int locks_held;
+
+static void memory_unlock(struct memory_alloc_t **ctx) {
+  locks_held--;
+  pthread_mutex_unlock(&(*ctx)->lock);
+}
+
+/* freed lifelike areas of the calling thread, by number of blocks */
+struct memory_cache {
+  int disabled;
+  struct memory_alloc_t *ctx;
+  int nb[MEMORY_CACHE_CLASSES + 1];
+  int addr[MEMORY_CACHE_CLASSES + 1][MEMORY_CACHE_SIZE];
+};
+static _Thread_local struct memory_cache cache;
+
+/* lock ctx until the end of the enclosing block */
+#define MEMORY_GUARD(ctx)                                                       \
+  struct memory_alloc_t *memory_guard __attribute__((cleanup(memory_unlock))) = (ctx); \
+  pthread_mutex_lock(&memory_guard->lock);                                      \
+  locks_held++
+#else
+#define MEMORY_GUARD(ctx) ((void)0)
+#endif
+
+/* Return non-zero if the placement policy of ctx uses the treap */
+static int has_tree(struct memory_alloc_t *ctx) {
+  return POLICY(ctx)->indexed;
+}
+
+/* Return non-zero if the engine of ctx tags and links its extents */
+static int has_extents(struct memory_alloc_t *ctx) {
+  return ctx->engine != MEMORY_BITMAP;
+}
+
+/* Return the priority of the extent starting at node in the treap, a
+ * hash of its head so that the tree is balanced on average
+ */
+static uint32_t tree_priority(int node) {
+  uint32_t h = node;
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+/* Return non-zero if the extent starting at a comes before the one
+ * starting at b in the treap: shorter, or as long at a lower address
+ */
+static int tree_before(struct memory_alloc_t *ctx, int a, int b) {
+  return ctx->extent_len[a] < ctx->extent_len[b]
+    || (ctx->extent_len[a] == ctx->extent_len[b] && a < b);
+}
+
+/* Insert node in the treap rooted at root. Return the new root */
+static int tree_insert(struct memory_alloc_t *ctx, int root, int node) {
+  if(root == NULL_BLOCK) {
+    ctx->tree_left[node] = NULL_BLOCK;
+    ctx->tree_right[node] = NULL_BLOCK;
+    return node;
+  }
+  if(tree_before(ctx, node, root)) {
+    int child = tree_insert(ctx, ctx->tree_left[root], node);
+    ctx->tree_left[root] = child;
+    if(tree_priority(child) > tree_priority(root)) { // rotate right
+      ctx->tree_left[root] = ctx->tree_right[child];
+      ctx->tree_right[child] = root;
+      return child;
+    }
+  }else{
+    int child = tree_insert(ctx, ctx->tree_right[root], node);
+    ctx->tree_right[root] = child;
+    if(tree_priority(child) > tree_priority(root)) { // rotate left
+      ctx->tree_right[root] = ctx->tree_left[child];
+      ctx->tree_left[child] = root;
+      return child;
+    }
+  }
+  return root;
+}
+
+/* Merge the treaps a and b, all the nodes of a coming before those of b.
+ * Return the new root.
+ */
+static int tree_merge(struct memory_alloc_t *ctx, int a, int b) {
+  if(a == NULL_BLOCK) { return b; }
+  if(b == NULL_BLOCK) { return a; }
+  if(tree_priority(a) > tree_priority(b)) {
+    ctx->tree_right[a] = tree_merge(ctx, ctx->tree_right[a], b);
+    return a;
+  }
+  ctx->tree_left[b] = tree_merge(ctx, a, ctx->tree_left[b]);
+  return b;
+}
+
+/* Remove node from the treap rooted at root. Return the new root */
+static int tree_remove(struct memory_alloc_t *ctx, int root, int node) {
+  if(root == node) {
+    return tree_merge(ctx, ctx->tree_left[node], ctx->tree_right[node]);
+  }
+  if(tree_before(ctx, node, root)) {
+    ctx->tree_left[root] = tree_remove(ctx, ctx->tree_left[root], node);
+  }else{
+    ctx->tree_right[root] = tree_remove(ctx, ctx->tree_right[root], node);
+  }
+  return root;
+}
+
+/* Return the head of the smallest extent of at least block_nb blocks,
+ * the lowest one among those of the same length: O(log n) on average.
+ * NULL_BLOCK if there is none.
+ */
+static int tree_best_fit(struct memory_alloc_t *ctx, size_t block_nb) {
+  int best = NULL_BLOCK;
+  int node = ctx->tree_root;
+  while(node != NULL_BLOCK) {
+    ctx->nb_inspected++;
+    if(ctx->extent_len[node] >= block_nb) {
+      best = node;
+      node = ctx->tree_left[node];
+    }else{
+      node = ctx->tree_right[node];
+    }
+  }
+  return best;
+}
+
+/* Return the head of the largest extent if it has at least block_nb
+ * blocks, NULL_BLOCK otherwise
+ */
+static int tree_worst_fit(struct memory_alloc_t *ctx, size_t block_nb) {
+  int node = ctx->tree_root;
+  if(node == NULL_BLOCK) { return NULL_BLOCK; }
+  while(ctx->tree_right[node] != NULL_BLOCK) {
+    ctx->nb_inspected++;
+    node = ctx->tree_right[node];
+  }
+  return ctx->extent_len[node] >= block_nb ? node : NULL_BLOCK;
+}
+
+/* Add the extent of len blocks starting at head: set its boundary tags
+ * and push it on the list of its size class
+ */
+static void extent_insert(struct memory_alloc_t *ctx, int head, size_t len) {
+  int class = size_class(len);
+  if(len > ctx->largest_extent) { ctx->largest_extent = len; }
+  free_list_push(ctx, &ctx->class_head[class], head, len);
+  ctx->class_map |= 1ULL << class;
+  if(has_tree(ctx)) {
+    ctx->tree_root = tree_insert(ctx, ctx->tree_root, head);
+  }
+}
+
+/* Remove the extent starting at head from the list of its size class */
+static void extent_remove(struct memory_alloc_t *ctx, int head) {
+  int class = size_class(ctx->extent_len[head]);
+  if(free_list_unlink(ctx, &ctx->class_head[class], head)) {
+    ctx->class_map &= ~(1ULL << class);
+  }
+  if(has_tree(ctx)) {
+    ctx->tree_root = tree_remove(ctx, ctx->tree_root, head);
+  }
+}
+
+/* Empty the lists of the size classes, the treap and the lists of the
+ * TLSF engine
+ */
+static void clear_classes(struct memory_alloc_t *ctx) {
+  ctx->tree_root = NULL_BLOCK;
+  ctx->largest_extent = 0;
+  for(int class = 0; class < MEMORY_NB_CLASSES; class++) {
+    ctx->class_head[class] = NULL_BLOCK;
+  }
+  ctx->class_map = 0;
+  for(int fl = 0; fl < MEMORY_TLSF_FL; fl++) {
+    for(int sl = 0; sl < MEMORY_TLSF_SL; sl++) {
+      ctx->tlsf_head[fl][sl] = NULL_BLOCK;
+    }
+    ctx->tlsf_sl_map[fl] = 0;
+  }
+  ctx->tlsf_fl_map = 0;
+}
+
+/* Compute the TLSF lists of the extents of len blocks: fl is the power
+ * of two of len (lengths below MEMORY_TLSF_SL share fl 0), sl the range
+ * of len within this power of two.
+ */
+static void tlsf_mapping(size_t len, int *fl, int *sl) {
+  if(len < MEMORY_TLSF_SL) {
+    *fl = 0;
+    *sl = len;
+    return;
+  }
+  int log = 63 - __builtin_clzll(len);
+  *fl = log - MEMORY_TLSF_SL_LOG + 1;
+  *sl = (len >> (log - MEMORY_TLSF_SL_LOG)) - MEMORY_TLSF_SL;
+}
+
+/* Add the extent of len blocks starting at head to the TLSF lists */
+static void tlsf_insert(struct memory_alloc_t *ctx, int head, size_t len) {
+  int fl, sl;
+  if(len > ctx->largest_extent) { ctx->largest_extent = len; }
+  tlsf_mapping(len, &fl, &sl);
+  free_list_push(ctx, &ctx->tlsf_head[fl][sl], head, len);
+  ctx->tlsf_sl_map[fl] |= 1U << sl;
+  ctx->tlsf_fl_map |= 1U << fl;
+}
+
+/* Remove the extent starting at head from the TLSF lists */
+static void tlsf_remove(struct memory_alloc_t *ctx, int head) {
+  int fl, sl;
+  tlsf_mapping(ctx->extent_len[head], &fl, &sl);
+  if(free_list_unlink(ctx, &ctx->tlsf_head[fl][sl], head)) {
+    ctx->tlsf_sl_map[fl] &= ~(1U << sl);
+    if(ctx->tlsf_sl_map[fl] == 0) {
+      ctx->tlsf_fl_map &= ~(1U << fl);
+    }
+  }
+}
+
+/* Return non-zero if block starts an extent, i.e. a run of available
+ * blocks that is not preceded by an available block
+ */
+static int is_extent_head(struct memory_alloc_t *ctx, int block) {
+  return bitmap_get(&ctx->free_map, block)
+    && (block == 0 || !bitmap_get(&ctx->free_map, block-1));
+}
+
+/* Recompute the length of every extent from the free blocks bitmap */
+static void rebuild_extents(struct memory_alloc_t *ctx) {
+  clear_classes(ctx);
+  int head = bitmap_next(&ctx->free_map, 0);
+  while(head != NULL_BLOCK) {
+    size_t end = bitmap_next_clear(&ctx->free_map, head);
+    extent_insert(ctx, head, end - head);
+    head = bitmap_next(&ctx->free_map, end);
+  }
+}
+
+/* Rebuild the structures of the engine of ctx from the free blocks
+ * bitmap. The list engine gets a list sorted by address.
+ */
+static void rebuild_free_lists(struct memory_alloc_t *ctx) {
+  if(ctx->engine == MEMORY_LIST) {
+    ctx->first_block = bitmap_next(&ctx->free_map, 0);
+    for(int head = ctx->first_block; head != NULL_BLOCK; ) {
+      size_t end = bitmap_next_clear(&ctx->free_map, head);
+      for(size_t i = head; i + 1 < end; i++) {
+        ctx->blocks[i] = i+1;
+      }
+      head = bitmap_next(&ctx->free_map, end);
+      ctx->blocks[end-1] = head; // the last block of a run links to the next run
+    }
+    ctx->sorted = 1;
+    ctx->unsorted_frees = 0;
+    rebuild_extents(ctx);
+  }else if(ctx->engine == MEMORY_TLSF) {
+    clear_classes(ctx);
+    for(int head = bitmap_next(&ctx->free_map, 0); head != NULL_BLOCK; ) {
+      size_t end = bitmap_next_clear(&ctx->free_map, head);
+      tlsf_insert(ctx, head, end - head);
+      head = bitmap_next(&ctx->free_map, end);
+    }
+  }else if(ctx->engine == MEMORY_BITMAP) {
+    ctx->largest_extent = 0;
+    for(int head = bitmap_next(&ctx->free_map, 0); head != NULL_BLOCK; ) {
+      size_t end = bitmap_next_clear(&ctx->free_map, head);
+      if(end - head > ctx->largest_extent) { ctx->largest_extent = end - head; }
+      head = bitmap_next(&ctx->free_map, end);
+    }
+  }
+}
+
+/* Return the placement policy matching placement */
+static const struct memory_policy *placement_policy(enum memory_placement placement) {
+  switch(placement) {
+  case MEMORY_NEXT_FIT:
+    return &memory_next_fit_policy;
+  case MEMORY_BEST_FIT:
+    return &memory_best_fit_policy;
+  case MEMORY_WORST_FIT:
+    return &memory_worst_fit_policy;
+  case MEMORY_SIZE_CLASS:
+    return &memory_size_class_policy;
+  default:
+    return &memory_first_fit_policy;
+  }
+}
+
+/* Give the nb_blocks blocks of the heap to the buddy engine, as the
+ * largest aligned powers of two that fit
+ */
+static void buddy_init(struct memory_alloc_t *ctx, size_t nb_blocks) {
+  size_t start = 0;
+  for(int order = 63; order >= 0; order--) {
+    size_t size = (size_t)1 << order;
+    if(nb_blocks & size) {
+      extent_insert(ctx, start, size);
+      start += size;
+    }
+  }
+}
+
+/* Initialize the memory allocator with a heap of nb_blocks blocks */
+void memory_ctx_init(struct memory_alloc_t *ctx, size_t nb_blocks) {
+  memory_ctx_init_with(ctx, NULL, nb_blocks, NULL);
+}
+
+/* Initialize the memory allocator with the blocks of a caller-provided region */
+void memory_ctx_init_region(struct memory_alloc_t *ctx, memory_page_t *region, size_t nb_blocks) {
+  memory_ctx_init_with(ctx, region, nb_blocks, NULL);
+}
+
+/* Initialize the memory allocator with the options of the heap */
+void memory_ctx_init_with(struct memory_alloc_t *ctx, memory_page_t *region, size_t nb_blocks,
+                          const struct memory_options *options) {
+  enum memory_errno error_no = E_SUCCESS;
+  ctx->engine = options != NULL ? options->engine : MEMORY_LIST;
+  ctx->policy = &memory_first_fit_policy;
+  if(options != NULL && ctx->engine == MEMORY_LIST) {
+    ctx->policy = options->policy != NULL ? options->policy : placement_policy(options->placement);
+  }
+#ifdef MEMORY_POLICY
+  ctx->policy = &MEMORY_POLICY;
+#endif
+  ctx->cursor = 0;
+  ctx->nb_inspected = 0;
+  ctx->defrag_pos = 0;
+  ctx->owns_blocks = 0;
+  ctx->handles = NULL;
+  ctx->nb_handles = 0;
+  ctx->handles_capacity = 0;
+  ctx->free_handles = NULL;
+  ctx->nb_free_handles = 0;
+  ctx->area_handles = NULL;
+  ctx->remote_frees = NULL_BLOCK;
+#ifdef MEMORY_THREAD_SAFE
+  if(cache.ctx == ctx) { // its areas belonged to the previous heap
+    cache.ctx = NULL;
+    memset(cache.nb, 0, sizeof(cache.nb));
+  }
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&ctx->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+#endif
+  if(region == NULL) {
+    if(nb_blocks > 0 && nb_blocks <= MAX_SIZE) {
+      region = calloc(nb_blocks, sizeof(memory_page_t));
+    }
+    if(region == NULL) {
+      error_no = E_NOMEM;
+      nb_blocks = 0;
+    }else{
+      ctx->owns_blocks = 1;
+    }
+  }
+  ctx->blocks = region;
+  ctx->extent_len = NULL;
+  ctx->class_next = NULL;
+  ctx->class_prev = NULL;
+  if(has_extents(ctx)) {
+    ctx->extent_len = malloc((nb_blocks > 0 ? nb_blocks : 1) * sizeof(int));
+    ctx->class_next = malloc((nb_blocks > 0 ? nb_blocks : 1) * sizeof(int));
+    ctx->class_prev = malloc((nb_blocks > 0 ? nb_blocks : 1) * sizeof(int));
+  }
+  ctx->tree_left = NULL;
+  ctx->tree_right = NULL;
+  if(has_tree(ctx)) {
+    ctx->tree_left = malloc((nb_blocks > 0 ? nb_blocks : 1) * sizeof(int));
+    ctx->tree_right = malloc((nb_blocks > 0 ? nb_blocks : 1) * sizeof(int));
+  }
+  int header_map_failed = bitmap_init(&ctx->header_map, nb_blocks) != 0;
+  int zero_map_failed = bitmap_init(&ctx->zero_map, nb_blocks) != 0;
+  if(bitmap_init(&ctx->free_map, nb_blocks) != 0 || header_map_failed || zero_map_failed
+     || (has_extents(ctx) && (ctx->extent_len == NULL || ctx->class_next == NULL || ctx->class_prev == NULL))
+     || (has_tree(ctx) && (ctx->tree_left == NULL || ctx->tree_right == NULL))) {
+    error_no = E_NOMEM;
+    nb_blocks = 0;
+  }
+  ctx->nb_blocks = nb_blocks;
+  ctx->available_blocks = nb_blocks;
+  ctx->first_block = NULL_BLOCK;
+  ctx->sorted = 1;
+  ctx->unsorted_frees = 0;
+  clear_classes(ctx);
+  if(nb_blocks > 0) {
+    bitmap_assign(&ctx->free_map, 0, nb_blocks, 1);
+    if(ctx->owns_blocks && ctx->engine != MEMORY_LIST) { // calloc() zeroed them
+      bitmap_assign(&ctx->zero_map, 0, nb_blocks, 1);
+    }
+  }
+  if(ctx->engine == MEMORY_BITMAP) {
+    ctx->largest_extent = nb_blocks;
+  }
+  if(ctx->engine == MEMORY_BUDDY) {
+    buddy_init(ctx, nb_blocks);
+  }else if(ctx->engine == MEMORY_TLSF && nb_blocks > 0) {
+    tlsf_insert(ctx, 0, nb_blocks);
+  }else if(ctx->engine == MEMORY_LIST && nb_blocks > 0) {
+    for (size_t i = 0; i + 1 < nb_blocks; i++)
+    {
+      ctx->blocks[i] = i+1;
+    }
+    ctx->blocks[nb_blocks-1] = NULL_BLOCK;
+    ctx->first_block = 0;
+    extent_insert(ctx, 0, nb_blocks);
+  }
+  ctx->error_no = error_no;
+}
+
+/* Release the blocks allocated by memory_ctx_init */
+void memory_ctx_destroy(struct memory_alloc_t *ctx) {
+  memory_ctx_cache_flush(ctx);
+#ifdef MEMORY_THREAD_SAFE
+  pthread_mutex_destroy(&ctx->lock);
+#endif
+  if(ctx->owns_blocks) {
+    free(ctx->blocks);
+  }
+  bitmap_destroy(&ctx->free_map);
+  bitmap_destroy(&ctx->header_map);
+  bitmap_destroy(&ctx->zero_map);
+  free(ctx->extent_len);
+  free(ctx->class_next);
+  free(ctx->class_prev);
+  free(ctx->tree_left);
+  free(ctx->tree_right);
+  for(size_t chunk = 0; chunk < ctx->handles_capacity / MEMORY_HANDLE_CHUNK; chunk++) {
+    free(ctx->handles[chunk]);
+  }
+  free(ctx->handles);
+  free(ctx->free_handles);
+  free(ctx->area_handles);
+  ctx->handles = NULL;
+  ctx->nb_handles = 0;
+  ctx->handles_capacity = 0;
+  ctx->free_handles = NULL;
+  ctx->nb_free_handles = 0;
+  ctx->area_handles = NULL;
+  ctx->extent_len = NULL;
+  ctx->class_next = NULL;
+  ctx->class_prev = NULL;
+  ctx->tree_left = NULL;
+  ctx->tree_right = NULL;
+  ctx->blocks = NULL;
+  ctx->nb_blocks = 0;
+  ctx->owns_blocks = 0;
+  ctx->available_blocks = 0;
+  ctx->first_block = NULL_BLOCK;
+}
+
+/* Recompute the bookkeeping of the allocator from the list of available blocks */
+void memory_ctx_sync(struct memory_alloc_t *ctx) {
+  MEMORY_GUARD(ctx);
+  if(ctx->engine != MEMORY_LIST) { return; }
+  bitmap_assign(&ctx->free_map, 0, ctx->nb_blocks, 0);
+  ctx->sorted = 1;
+  ctx->unsorted_frees = 0;
+  int prev = NULL_BLOCK;
+  for(int index = ctx->first_block; index != NULL_BLOCK; index = ctx->blocks[index]) {
+    if(prev != NULL_BLOCK && index < prev) {
+      ctx->sorted = 0;
+    }
+    bitmap_assign(&ctx->free_map, index, 1, 1);
+    prev = index;
+  }
+  if(ctx->sorted) {
+    rebuild_extents(ctx);
+  }else{ // the runs are not known: only the number of blocks bounds them
+    ctx->largest_extent = ctx->available_blocks;
   }
-  m.blocks[i] = NULL_BLOCK;
-  m.error_no = E_SUCCESS;
 }
 
 /* Return the number of consecutive blocks starting from first */
-int nb_consecutive_blocks(int first) {
+int memory_ctx_nb_consecutive_blocks(struct memory_alloc_t *ctx, int first) {
+  MEMORY_GUARD(ctx);
+  if(first == NULL_BLOCK) { return 0; }
+  if(ctx->engine != MEMORY_LIST) {
+    return bitmap_get(&ctx->free_map, first) ? bitmap_next_clear(&ctx->free_map, first) - first : 0;
+  }
+  if(ctx->sorted && bitmap_get(&ctx->free_map, first)) { // first belongs to an extent
+    if(is_extent_head(ctx, first)) {
+      return ctx->extent_len[first];
+    }
+    return bitmap_next_clear(&ctx->free_map, first) - first;
+  }
   int index = first;
   int nb_consecutive_blocks = 1;
-  while(index+1 == m.blocks[index]){
+  while(index+1 == ctx->blocks[index]){
     nb_consecutive_blocks++;
     index++;
   }
   return nb_consecutive_blocks;
 }
 
-/* Reorder memory blocks */
-void memory_reorder() {
-  for(int i = m.available_blocks; i > 1; i--){
-    int index = 0;
-    for(int u = 0; u < i-1; u++) {
-      if(u==0){
-        if(m.first_block > m.blocks[m.first_block]){
-          memory_page_t blo = m.blocks[m.first_block];
-          memory_page_t bloblo = m.blocks[m.blocks[m.first_block]];
-          m.blocks[m.blocks[m.first_block]] = m.first_block;
-          m.blocks[m.first_block] = bloblo;
-          m.first_block = blo;
-        }
-        index = m.first_block;
-      }else{
-        if(m.blocks[index] > m.blocks[m.blocks[index]]){
-          memory_page_t blo = m.blocks[index]; 
-          memory_page_t bloblo = m.blocks[m.blocks[index]];
-          memory_page_t blobloblo = m.blocks[m.blocks[m.blocks[index]]];
-          m.blocks[m.blocks[m.blocks[index]]] = blo;
-          m.blocks[m.blocks[index]] = blobloblo;
-          m.blocks[index] = bloblo;
-        }
-        index = m.blocks[index];
-      }
-    }
-  }
+/* Reorder memory blocks: the list is relinked in address order by a
+ * sweep of the free blocks bitmap, in O(n)
+ */
+void memory_ctx_reorder(struct memory_alloc_t *ctx) {
+  MEMORY_GUARD(ctx);
+  if(ctx->engine != MEMORY_LIST) { return; }
+  rebuild_free_lists(ctx);
+}
+
+/* Look for block_nb consecutive available blocks in an unsorted list,
+ * first-fit. Return the first block of the run or NULL_BLOCK if there
+ * is none. prev is set to the block linking to the run (NULL_BLOCK if
+ * the run starts at ctx->first_block).
+ */
+static int find_consecutive_blocks(struct memory_alloc_t *ctx, size_t block_nb, int *prev) {
+  int index = ctx->first_block;
+  *prev = NULL_BLOCK;
+  while(index != NULL_BLOCK) {
+    ctx->nb_inspected++;
+    if(memory_ctx_nb_consecutive_blocks(ctx, index) >= block_nb) {
+      return index;
+    }
+    *prev = index;
+    index = ctx->blocks[index];
+  }
+  return NULL_BLOCK;
+}
+
+/* Remove the block_nb blocks starting at first from the list of
+ * available blocks. prev is the block linking to first. When the list
+ * is sorted, first must be the head of an extent.
+ */
+static void unlink_blocks(struct memory_alloc_t *ctx, int prev, int first, size_t block_nb) {
+  if(ctx->sorted) {
+    size_t len = ctx->extent_len[first];
+    extent_remove(ctx, first);
+    if(len > block_nb) { // the rest of the extent remains
+      extent_insert(ctx, first + block_nb, len - block_nb);
+    }
+  }
+  int next = ctx->blocks[first + block_nb-1];
+  if(prev == NULL_BLOCK) {
+    ctx->first_block = next;
+  }else{
+    ctx->blocks[prev] = next;
+  }
+  bitmap_assign(&ctx->free_map, first, block_nb, 0);
+  ctx->available_blocks-=block_nb;
+}
+
+/* Return the block linking to block in the list of available blocks */
+static int find_prev_block(struct memory_alloc_t *ctx, int block) {
+  if(ctx->sorted) {
+    return bitmap_prev(&ctx->free_map, block);
+  }
+  int prev = NULL_BLOCK;
+  int index = ctx->first_block;
+  while(index != block) {
+    prev = index;
+    index = ctx->blocks[index];
+  }
+  return prev;
+}
+
+/* Give back the block_nb blocks starting at first to the list of
+ * available blocks. A sorted list is kept sorted, an unsorted list
+ * gets the blocks at its head.
+ */
+static void release_blocks(struct memory_alloc_t *ctx, int first, size_t block_nb) {
+  int prev = NULL_BLOCK;
+  int next = ctx->first_block;
+  if(ctx->sorted) {
+    if(first > 0 && bitmap_get(&ctx->free_map, first-1)) { // the extent on the left links to us
+      prev = first-1;
+    }else{
+      prev = bitmap_prev(&ctx->free_map, first);
+    }
+    if(prev != NULL_BLOCK) { next = ctx->blocks[prev]; }
+  }
+  for (size_t i = first; i < first+block_nb-1; i++)
+  {
+    ctx->blocks[i] = i+1;
+  }
+  ctx->blocks[first+block_nb-1] = next;
+  if(prev == NULL_BLOCK) {
+    ctx->first_block = first;
+  }else{
+    ctx->blocks[prev] = first;
+  }
+  if(ctx->sorted) { // merge with the extents around, using their boundary tags
+    int head = first;
+    size_t len = block_nb;
+    if(first+block_nb < ctx->nb_blocks && bitmap_get(&ctx->free_map, first+block_nb)) {
+      len += ctx->extent_len[first+block_nb];
+      extent_remove(ctx, first+block_nb);
+    }
+    if(prev != NULL_BLOCK && prev == first-1) {
+      head = first - ctx->extent_len[first-1];
+      len += first - head;
+      extent_remove(ctx, head);
+    }
+    extent_insert(ctx, head, len);
+  }
+  bitmap_assign(&ctx->free_map, first, block_nb, 1);
+  ctx->available_blocks += block_nb;
+  if(!ctx->sorted) { // sort once enough frees have piled up, in O(n) for all of them
+    ctx->largest_extent = ctx->available_blocks;
+    ctx->unsorted_frees += block_nb;
+    if(ctx->unsorted_frees * MEMORY_REORDER_RATIO >= ctx->available_blocks) {
+      memory_ctx_reorder(ctx);
+    }
+  }
+}
+
+/* Look for an extent of at least block_nb blocks in the size classes.
+ * The first non-empty class that fits is used, so that small requests
+ * are served in O(1). Only the class of block_nb itself may hold
+ * extents that are too small. The list must be sorted.
+ * Return the head of the extent or NULL_BLOCK if there is none.
+ */
+static int find_extent_in_classes(struct memory_alloc_t *ctx, size_t block_nb) {
+  int class = size_class(block_nb);
+  uint64_t classes = ctx->class_map & (~0ULL << class);
+  while(classes != 0) {
+    int k = __builtin_ctzll(classes);
+    int head = ctx->class_head[k];
+    ctx->nb_inspected++;
+    if(k != class || k < MEMORY_EXACT_CLASSES) {
+      return head;
+    }
+    for(; head != NULL_BLOCK; head = ctx->class_next[head]) {
+      ctx->nb_inspected++;
+      if(ctx->extent_len[head] >= block_nb) {
+        return head;
+      }
+    }
+    classes &= classes - 1;
+  }
+  return NULL_BLOCK;
+}
+
+/* First-fit: walk the extents of the sorted list in address order,
+ * checking only the length of each one
+ */
+static int find_first_fit(struct memory_alloc_t *ctx, size_t block_nb) {
+  for(int index = ctx->first_block; index != NULL_BLOCK;
+      index = ctx->blocks[index + ctx->extent_len[index] - 1]) {
+    ctx->nb_inspected++;
+    if(ctx->extent_len[index] >= block_nb) {
+      return index;
+    }
+  }
+  return NULL_BLOCK;
+}
+
+/* Next-fit: walk the extents of the sorted list from the one holding or
+ * following ctx->cursor, wrapping around to ctx->first_block
+ */
+static int find_next_fit(struct memory_alloc_t *ctx, size_t block_nb) {
+  int start = NULL_BLOCK;
+  if(ctx->cursor < ctx->nb_blocks) {
+    start = bitmap_next(&ctx->free_map, ctx->cursor);
+  }
+  if(start != NULL_BLOCK && !is_extent_head(ctx, start)) { // the cursor is inside an extent
+    size_t end = bitmap_next_clear(&ctx->free_map, start);
+    start = end - ctx->extent_len[end-1];
+  }
+  if(start == NULL_BLOCK) {
+    start = ctx->first_block;
+  }
+  int index = start;
+  while(index != NULL_BLOCK) {
+    ctx->nb_inspected++;
+    if(ctx->extent_len[index] >= block_nb) {
+      return index;
+    }
+    index = ctx->blocks[index + ctx->extent_len[index] - 1];
+    if(index == NULL_BLOCK) { // wrap around
+      index = ctx->first_block;
+    }
+    if(index == start) {
+      break;
+    }
+  }
+  return NULL_BLOCK;
+}
+
+/* The placement policies. Lifelike areas are placed with the size
+ * classes under first-fit.
+ */
+const struct memory_policy memory_first_fit_policy = { find_first_fit, find_extent_in_classes, 0 };
+const struct memory_policy memory_next_fit_policy = { find_next_fit, find_next_fit, 0 };
+const struct memory_policy memory_best_fit_policy = { tree_best_fit, tree_best_fit, 1 };
+const struct memory_policy memory_worst_fit_policy = { tree_worst_fit, tree_worst_fit, 1 };
+const struct memory_policy memory_size_class_policy = { find_extent_in_classes, find_extent_in_classes, 0 };
+
+/* Look for block_nb consecutive available blocks with the placement
+ * policy of ctx, or first-fit in an unsorted list.
+ * prev is set as in find_consecutive_blocks().
+ */
+static int find_placed_blocks(struct memory_alloc_t *ctx, size_t block_nb, int lifelike, int *prev) {
+  if(!ctx->sorted) {
+    return find_consecutive_blocks(ctx, block_nb, prev);
+  }
+  int first = lifelike ? POLICY(ctx)->find_lifelike(ctx, block_nb) : POLICY(ctx)->find(ctx, block_nb);
+  *prev = first == NULL_BLOCK ? NULL_BLOCK : bitmap_prev(&ctx->free_map, first);
+  return first;
+}
+
+/* Take a free block of block_nb blocks, a power of two, from the buddy
+ * engine. The smallest free block that is large enough is split in
+ * halves until it has the right size: O(log n).
+ * Return its first block or NULL_BLOCK if there is none.
+ */
+static int buddy_take(struct memory_alloc_t *ctx, size_t block_nb) {
+  if(block_nb > ctx->nb_blocks) { return NULL_BLOCK; }
+  int first = find_extent_in_classes(ctx, block_nb);
+  if(first == NULL_BLOCK) { return NULL_BLOCK; }
+  size_t size = ctx->extent_len[first];
+  extent_remove(ctx, first);
+  while(size > block_nb) { // the upper half stays available
+    size /= 2;
+    extent_insert(ctx, first + size, size);
+  }
+  bitmap_assign(&ctx->free_map, first, block_nb, 0);
+  ctx->available_blocks -= block_nb;
+  return first;
+}
+
+/* Give back to the buddy engine the block_nb blocks, a power of two,
+ * starting at first. The block is merged with its buddy, found by
+ * xor-ing its index with its size, as long as the buddy is free and
+ * has the same size: O(log n).
+ */
+static void buddy_give(struct memory_alloc_t *ctx, int first, size_t block_nb) {
+  bitmap_assign(&ctx->free_map, first, block_nb, 1);
+  ctx->available_blocks += block_nb;
+  while(block_nb < ctx->nb_blocks) {
+    size_t buddy = first ^ block_nb;
+    // a free buddy is the head of its free block since it is aligned on block_nb
+    if(buddy + block_nb > ctx->nb_blocks || !bitmap_get(&ctx->free_map, buddy)
+       || ctx->extent_len[buddy] != block_nb) {
+      break;
+    }
+    extent_remove(ctx, buddy);
+    first &= ~block_nb;
+    block_nb *= 2;
+  }
+  extent_insert(ctx, first, block_nb);
+}
+
+/* Mark the block_nb available blocks starting at first as allocated */
+static void bitmap_take_at(struct memory_alloc_t *ctx, int first, size_t block_nb) {
+  bitmap_assign(&ctx->free_map, first, block_nb, 0);
+  ctx->available_blocks -= block_nb;
+}
+
+/* Take block_nb consecutive blocks from the bitmap engine, first-fit.
+ * Only the free blocks bitmap is read. Return the first block or
+ * NULL_BLOCK if there is none.
+ */
+static int bitmap_take(struct memory_alloc_t *ctx, size_t block_nb) {
+  int first = bitmap_find_run(&ctx->free_map, block_nb);
+  if(first != NULL_BLOCK) {
+    bitmap_take_at(ctx, first, block_nb);
+  }
+  return first;
+}
+
+/* Give back the block_nb blocks starting at first to the bitmap engine */
+static void bitmap_give(struct memory_alloc_t *ctx, int first, size_t block_nb) {
+  bitmap_assign(&ctx->free_map, first, block_nb, 1);
+  ctx->available_blocks += block_nb;
+  size_t len = bitmap_next_clear(&ctx->free_map, first + block_nb) - bitmap_run_start(&ctx->free_map, first);
+  if(len > ctx->largest_extent) { ctx->largest_extent = len; }
+}
+
+/* Return an extent of at least block_nb blocks from the list of
+ * block_nb itself, whose extents may also be shorter: O(length of the
+ * list). Return NULL_BLOCK if there is none.
+ */
+static int tlsf_find_in_list(struct memory_alloc_t *ctx, size_t block_nb) {
+  int fl, sl;
+  tlsf_mapping(block_nb, &fl, &sl);
+  for(int head = ctx->tlsf_head[fl][sl]; head != NULL_BLOCK; head = ctx->class_next[head]) {
+    if(ctx->extent_len[head] >= block_nb) {
+      return head;
+    }
+  }
+  return NULL_BLOCK;
+}
+
+/* Take block_nb consecutive blocks from the TLSF engine. The request is
+ * rounded up to the next second level range so that any extent of the
+ * first non-empty list found with the two bitmaps is large enough: O(1).
+ * When there is none, the list of block_nb itself is searched, so that
+ * an extent of block_nb blocks is not missed. The rest of the extent
+ * stays available.
+ * Return the first block or NULL_BLOCK if there is none.
+ */
+static int tlsf_take(struct memory_alloc_t *ctx, size_t block_nb) {
+  size_t rounded = block_nb;
+  if(block_nb >= MEMORY_TLSF_SL) {
+    rounded += ((size_t)1 << (63 - __builtin_clzll(block_nb) - MEMORY_TLSF_SL_LOG)) - 1;
+  }
+  if(block_nb == 0 || block_nb > ctx->nb_blocks) { return NULL_BLOCK; }
+  int fl, sl;
+  tlsf_mapping(rounded, &fl, &sl);
+  uint32_t sl_map = ctx->tlsf_sl_map[fl] & (~0U << sl);
+  uint32_t fl_map = fl+1 < MEMORY_TLSF_FL ? ctx->tlsf_fl_map & (~0U << (fl+1)) : 0;
+  int first;
+  if(sl_map == 0 && fl_map == 0) { // no extent of rounded blocks or more
+    first = tlsf_find_in_list(ctx, block_nb);
+    if(first == NULL_BLOCK) { // the extents are all shorter than block_nb
+      if(block_nb - 1 < ctx->largest_extent) { ctx->largest_extent = block_nb - 1; }
+      return NULL_BLOCK;
+    }
+  }else{
+    if(sl_map == 0) { // look in the next non-empty power of two
+      fl = __builtin_ctz(fl_map);
+      sl_map = ctx->tlsf_sl_map[fl];
+    }
+    first = ctx->tlsf_head[fl][__builtin_ctz(sl_map)];
+  }
+  size_t len = ctx->extent_len[first];
+  tlsf_remove(ctx, first);
+  if(len > block_nb) {
+    tlsf_insert(ctx, first + block_nb, len - block_nb);
+  }
+  bitmap_assign(&ctx->free_map, first, block_nb, 0);
+  ctx->available_blocks -= block_nb;
+  return first;
+}
+
+/* Give back the block_nb blocks starting at first to the TLSF engine.
+ * They are merged at once with the extents on both sides, found with
+ * their boundary tags: O(1).
+ */
+static void tlsf_give(struct memory_alloc_t *ctx, int first, size_t block_nb) {
+  int head = first;
+  size_t len = block_nb;
+  if(first+block_nb < ctx->nb_blocks && bitmap_get(&ctx->free_map, first+block_nb)) {
+    len += ctx->extent_len[first+block_nb];
+    tlsf_remove(ctx, first+block_nb);
+  }
+  if(first > 0 && bitmap_get(&ctx->free_map, first-1)) {
+    head = first - ctx->extent_len[first-1];
+    len += first - head;
+    tlsf_remove(ctx, head);
+  }
+  tlsf_insert(ctx, head, len);
+  bitmap_assign(&ctx->free_map, first, block_nb, 1);
+  ctx->available_blocks += block_nb;
+}
+
+/* Return the number of blocks that the engine of ctx hands out for a
+ * request of block_nb blocks
+ */
+static size_t engine_block_nb(struct memory_alloc_t *ctx, size_t block_nb) {
+  if(ctx->engine == MEMORY_BUDDY) {
+    return block_nb <= 1 ? 1 : (size_t)1 << (64 - __builtin_clzll(block_nb - 1));
+  }
+  return block_nb;
+}
+
+/* Take block_nb consecutive available blocks with the engine of ctx,
+ * block_nb being already rounded by engine_block_nb(). lifelike selects
+ * the placement of memory_lifelike_malloc().
+ * Return the first block or NULL_BLOCK if there is none.
+ */
+static int take_blocks(struct memory_alloc_t *ctx, size_t block_nb, int lifelike) {
+  if(block_nb > ctx->largest_extent) { // O(1): no run is long enough
+    return NULL_BLOCK;
+  }
+  int first_block;
+  switch(ctx->engine) {
+  case MEMORY_BUDDY:
+    first_block = buddy_take(ctx, block_nb);
+    break;
+  case MEMORY_BITMAP:
+    first_block = bitmap_take(ctx, block_nb);
+    break;
+  case MEMORY_TLSF:
+    return tlsf_take(ctx, block_nb); // its searches are not exhaustive, it updates the bound itself
+  default: {
+    int prev;
+    first_block = find_placed_blocks(ctx, block_nb, lifelike, &prev);
+    if(first_block == NULL_BLOCK && !ctx->sorted){ // the needed nb of blocks is not available, maybe it is once sorted
+      memory_ctx_reorder(ctx);
+      first_block = find_placed_blocks(ctx, block_nb, lifelike, &prev); // we check again after memory reorder
+    }
+    if(first_block != NULL_BLOCK) {
+      unlink_blocks(ctx, prev, first_block, block_nb);
+      ctx->cursor = first_block + block_nb;
+    }
+    break;
+  }
+  }
+  if(first_block == NULL_BLOCK) { // the search looked at every run: they are all shorter
+    ctx->largest_extent = block_nb - 1;
+  }
+  return first_block;
+}
+
+/* Give back the block_nb blocks starting at first to the engine of ctx */
+static void give_blocks(struct memory_alloc_t *ctx, int first, size_t block_nb) {
+  bitmap_assign(&ctx->zero_map, first, block_nb, 0); // they may have been written
+  switch(ctx->engine) {
+  case MEMORY_BUDDY:
+    buddy_give(ctx, first, block_nb);
+    break;
+  case MEMORY_BITMAP:
+    bitmap_give(ctx, first, block_nb);
+    break;
+  case MEMORY_TLSF:
+    tlsf_give(ctx, first, block_nb);
+    break;
+  default:
+    release_blocks(ctx, first, block_nb);
+    break;
+  }
+}
+
+/* Take the block_nb first blocks of the run of available blocks starting
+ * at head from the engine of ctx (not the buddy engine)
+ */
+static void take_at(struct memory_alloc_t *ctx, int head, size_t block_nb) {
+  size_t len;
+  switch(ctx->engine) {
+  case MEMORY_TLSF:
+    len = ctx->extent_len[head];
+    tlsf_remove(ctx, head);
+    if(len > block_nb) {
+      tlsf_insert(ctx, head + block_nb, len - block_nb);
+    }
+    // fall through
+  case MEMORY_BITMAP:
+    bitmap_take_at(ctx, head, block_nb);
+    break;
+  default:
+    unlink_blocks(ctx, bitmap_prev(&ctx->free_map, head), head, block_nb);
+    break;
+  }
+}
+
+/* Take the whole run of available blocks starting at head from the
+ * engine of ctx (not the buddy engine). Return its number of blocks.
+ */
+static size_t take_extent(struct memory_alloc_t *ctx, int head) {
+  size_t len = bitmap_next_clear(&ctx->free_map, head) - head;
+  take_at(ctx, head, len);
+  return len;
+}
+
+#ifdef MEMORY_THREAD_SAFE
+/* Give the nb oldest areas of block_nb blocks of the cache back to ctx */
+static void cache_give(struct memory_alloc_t *ctx, size_t block_nb, int nb) {
+  MEMORY_GUARD(ctx);
+  for(int i = 0; i < nb; i++) {
+    give_blocks(ctx, cache.addr[block_nb][i] - 1, block_nb);
+  }
+  cache.nb[block_nb] -= nb;
+  memmove(cache.addr[block_nb], cache.addr[block_nb] + nb, cache.nb[block_nb] * sizeof(int));
+}
+
+/* Make the cache of the calling thread work on ctx. Return zero if it
+ * works on another heap, which cannot be flushed while a lock is held:
+ * two threads could each wait for the heap the other one locked.
+ */
+static int cache_bind(struct memory_alloc_t *ctx) {
+  if(cache.ctx != ctx) {
+    if(cache.ctx != NULL) {
+      if(locks_held > 0) {
+        return 0;
+      }
+      memory_ctx_cache_flush(cache.ctx);
+    }
+    cache.ctx = ctx;
+  }
+  return 1;
+}
+
+/* Return a lifelike area of block_nb blocks from the cache, refilled with
+ * half of its capacity at once if empty. NULL_BLOCK if it cannot be.
+ */
+static int cache_malloc(struct memory_alloc_t *ctx, size_t block_nb) {
+  if(block_nb > MEMORY_CACHE_CLASSES || cache.disabled || !cache_bind(ctx)) {
+    return NULL_BLOCK;
+  }
+  if(cache.nb[block_nb] == 0) {
+    MEMORY_GUARD(ctx);
+    while(cache.nb[block_nb] < MEMORY_CACHE_SIZE / 2 && block_nb <= ctx->available_blocks) {
+      int first = take_blocks(ctx, block_nb, 1);
+      if(first == NULL_BLOCK) {
+        break;
+      }
+      ctx->blocks[first] = block_nb*8 | MEMORY_CACHED;
+      cache.addr[block_nb][cache.nb[block_nb]++] = first+1;
+    }
+    if(cache.nb[block_nb] == 0) {
+      return NULL_BLOCK;
+    }
+  }
+  return cache.addr[block_nb][--cache.nb[block_nb]];
+}
+
+/* Put the lifelike area at addr in the cache, flushing half of it at once
+ * if full. Return zero if the area does not come from a cache, or if
+ * the cache cannot take it.
+ */
+static int cache_free(struct memory_alloc_t *ctx, int addr) {
+  memory_page_t header = ctx->blocks[addr-1];
+  if(!(header & MEMORY_CACHED)) {
+    return 0;
+  }
+  size_t block_nb = header/8;
+  if(cache.disabled || !cache_bind(ctx)) { // the area goes back to ctx
+    return 0;
+  }
+  if(cache.nb[block_nb] == MEMORY_CACHE_SIZE) {
+    cache_give(ctx, block_nb, MEMORY_CACHE_SIZE / 2);
+  }
+  cache.addr[block_nb][cache.nb[block_nb]++] = addr;
+  return 1;
+}
+#endif
+
+void memory_ctx_cache_flush(struct memory_alloc_t *ctx) {
+#ifdef MEMORY_THREAD_SAFE
+  if(cache.ctx != ctx) {
+    return;
+  }
+  for(size_t block_nb = 1; block_nb <= MEMORY_CACHE_CLASSES; block_nb++) {
+    if(cache.nb[block_nb] > 0) {
+      cache_give(ctx, block_nb, cache.nb[block_nb]);
+    }
+  }
+  cache.ctx = NULL;
+#else
+  (void)ctx;
+#endif
+}
+
+void memory_cache_enable(int enabled) {
+#ifdef MEMORY_THREAD_SAFE
+  if(!enabled && cache.ctx != NULL) {
+    memory_ctx_cache_flush(cache.ctx);
+  }
+  cache.disabled = !enabled;
+#else
+  (void)enabled;
+#endif
+}
+
+/* Push on a stack that only gets emptied at once: the link of a pushed
+ * area is never read by a pusher, so there is no ABA
+ */
+void memory_ctx_remote_free(struct memory_alloc_t *ctx, int addr) {
+  memory_page_t header = ctx->blocks[addr-1];
+  if((uint64_t)header >> 32) { // no room for the link
+    memory_ctx_lifelike_free(ctx, addr);
+    return;
+  }
+  int head = __atomic_load_n(&ctx->remote_frees, __ATOMIC_RELAXED);
+  do {
+    ctx->blocks[addr-1] = (memory_page_t)head << 32 | header;
+  } while(!__atomic_compare_exchange_n(&ctx->remote_frees, &head, addr, 1,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Free the areas pushed by memory_ctx_remote_free(), the lock of ctx
+ * held. They skip the cache, which could lock another heap.
+ */
+static void drain_remote_frees(struct memory_alloc_t *ctx) {
+  if(__atomic_load_n(&ctx->remote_frees, __ATOMIC_RELAXED) == NULL_BLOCK) {
+    return;
+  }
+  int addr = __atomic_exchange_n(&ctx->remote_frees, NULL_BLOCK, __ATOMIC_ACQUIRE);
+  while(addr != NULL_BLOCK) {
+    int next = (uint64_t)ctx->blocks[addr-1] >> 32;
+    size_t block_nb = (ctx->blocks[addr-1] & 0xffffffff)/8;
+    bitmap_assign(&ctx->header_map, addr-1, 1, 0);
+    give_blocks(ctx, addr-1, block_nb);
+    addr = next;
+  }
+}
+
+/* Zero the size bytes starting at block first, which was available,
+ * skipping the blocks known to hold zeros
+ */
+static void zero_blocks(struct memory_alloc_t *ctx, int first, size_t size) {
+  size_t end = first + size / 8 + (size % 8 != 0);
+  size_t i = bitmap_next_clear(&ctx->zero_map, first);
+  while(i < end) {
+    int zero = bitmap_next(&ctx->zero_map, i);
+    size_t stop = zero == NULL_BLOCK || (size_t)zero > end ? end : (size_t)zero;
+    memset(&ctx->blocks[i], 0, (stop - i) * sizeof(memory_page_t));
+    i = stop < end ? bitmap_next_clear(&ctx->zero_map, stop) : end;
+  }
+}
+
+/* Allocate size bytes, zeroed if zero is non-zero
+ * return NULL_BLOCK in case of an error
+ */
+static int allocate(struct memory_alloc_t *ctx, size_t size, int zero) {
+  MEMORY_GUARD(ctx);
+  drain_remote_frees(ctx);
+  size_t block_nb_needed = engine_block_nb(ctx, size / 8 + (size % 8 != 0));
+  if(block_nb_needed > ctx->available_blocks) { // no placement or reorder can help
+    ctx->error_no = E_NOMEM;
+    return NULL_BLOCK;
+  }
+  int first_block = take_blocks(ctx, block_nb_needed, 0);
+  if(first_block == NULL_BLOCK){
+    ctx->error_no = E_SHOULD_PACK;
+    return NULL_BLOCK;
+  }
+  if(zero) {
+    zero_blocks(ctx, first_block, size);
+  }
+  ctx->error_no = E_SUCCESS;
+  return first_block;
+}
+
+int memory_ctx_allocate(struct memory_alloc_t *ctx, size_t size) {
+  return allocate(ctx, size, 1);
+}
+
+int memory_ctx_allocate_nozero(struct memory_alloc_t *ctx, size_t size) {
+  return allocate(ctx, size, 0);
+}
+
+/* Free the block of data starting at address */
+void memory_ctx_free(struct memory_alloc_t *ctx, int address, size_t size) {
+  MEMORY_GUARD(ctx);
+  size_t block_nb = size / 8;
+  if(size % 8 != 0) { block_nb++; }
+  give_blocks(ctx, address, engine_block_nb(ctx, block_nb));
+  ctx->error_no = E_SUCCESS;
+}
+
+/* Print information on the available blocks of the memory allocator */
+void memory_ctx_print(struct memory_alloc_t *ctx) {
+  MEMORY_GUARD(ctx);
+  printf("---------------------------------\n");
+  printf("\tBlock size: %lu\n", sizeof(ctx->blocks[0]));
+  printf("\tAvailable blocks: %lu\n", ctx->available_blocks);
+  printf("\tFirst free: %d\n", ctx->first_block);
+  printf("\tError_no: "); memory_error_print(ctx->error_no);
+  printf("\tContent:  ");
+
+  switch(ctx->engine) {
+  case MEMORY_BUDDY: // free blocks by size
+    for(int class = 0; class < MEMORY_NB_CLASSES; class++) {
+      for(int head = ctx->class_head[class]; head != NULL_BLOCK; head = ctx->class_next[head]) {
+        printf("[%d..%d] ", head, head + ctx->extent_len[head] - 1);
+      }
+    }
+    break;
+  case MEMORY_BITMAP:
+  case MEMORY_TLSF: // runs of available blocks
+    for(int head = bitmap_next(&ctx->free_map, 0); head != NULL_BLOCK; ) {
+      size_t end = bitmap_next_clear(&ctx->free_map, head);
+      printf("[%d..%zu] ", head, end - 1);
+      head = bitmap_next(&ctx->free_map, end);
+    }
+    break;
+  default: {
+    int address = ctx->first_block;
+    while(address != NULL_BLOCK) {
+      printf("[%d] -> ", address);
+      address = ctx->blocks[address];
+    }
+    printf("NULL_BLOCK");
+    break;
+  }
+  }
+
+  printf("\n");
+  printf("---------------------------------\n");
+}
+
+/* Allocate a lifelike area of size bytes, zeroed if zero is non-zero */
+static int lifelike_malloc(struct memory_alloc_t *ctx, size_t size, int zero) {
+  // will look for size + 1 blocks
+  // will return the addr of the second block
+  size_t block_nb_needed = size / 8;
+  if(size % 8 != 0) block_nb_needed++;
+  block_nb_needed++; // add one block needed to store the nb of blocks
+  block_nb_needed = engine_block_nb(ctx, block_nb_needed);
+#ifdef MEMORY_THREAD_SAFE
+  int addr = cache_malloc(ctx, block_nb_needed);
+  if(addr != NULL_BLOCK) { // error_no is left untouched: it is shared
+    if(zero) { // cached areas may have been written
+      memory_ctx_initialize_buffer(ctx, addr, size);
+    }
+    return addr;
+  }
+#endif
+  MEMORY_GUARD(ctx);
+  drain_remote_frees(ctx);
+  if(block_nb_needed > ctx->available_blocks) {
+    ctx->error_no = E_NOMEM;
+    return NULL_BLOCK;
+  }
+  int first_block = take_blocks(ctx, block_nb_needed, 1);
+  if(first_block == NULL_BLOCK){
+    ctx->error_no = E_SHOULD_PACK;
+    return NULL_BLOCK;
+  }
+  ctx->blocks[first_block] = block_nb_needed*8; // Store the size in bytes needed
+  bitmap_assign(&ctx->header_map, first_block, 1, 1);
+  if(zero) {
+    zero_blocks(ctx, first_block+1, size);
+  }
+  ctx->error_no = E_SUCCESS;
+  return first_block+1;
+}
+
+int memory_ctx_lifelike_malloc(struct memory_alloc_t *ctx, size_t size) {
+  return lifelike_malloc(ctx, size, 1);
+}
+
+int memory_ctx_lifelike_malloc_nozero(struct memory_alloc_t *ctx, size_t size) {
+  return lifelike_malloc(ctx, size, 0);
+}
+
+int memory_ctx_lifelike_calloc(struct memory_alloc_t *ctx, size_t nmemb, size_t size) {
+  size_t bytes;
+  if(__builtin_mul_overflow(nmemb, size, &bytes)) {
+    ctx->error_no = E_NOMEM;
+    return NULL_BLOCK;
+  }
+  return lifelike_malloc(ctx, bytes, 1);
+}
+
+/* Carve the areas one run of available blocks after the other, the runs
+ * being walked once from the start of the heap
+ */
+size_t memory_ctx_lifelike_malloc_batch(struct memory_alloc_t *ctx, size_t size,
+                                        size_t count, int *out) {
+  size_t block_nb = size / 8;
+  if(size % 8 != 0) block_nb++;
+  block_nb++; // the header
+  block_nb = engine_block_nb(ctx, block_nb);
+  MEMORY_GUARD(ctx);
+  drain_remote_frees(ctx);
+  size_t n = 0;
+  if(ctx->engine == MEMORY_BUDDY) { // no runs to walk
+    for(int first; n < count && (first = take_blocks(ctx, block_nb, 1)) != NULL_BLOCK; n++) {
+      ctx->blocks[first] = block_nb*8;
+      bitmap_assign(&ctx->header_map, first, 1, 1);
+      out[n] = first+1;
+    }
+  }else if(block_nb <= ctx->available_blocks) {
+    if(ctx->engine == MEMORY_LIST && !ctx->sorted) {
+      memory_ctx_reorder(ctx);
+    }
+    int head = bitmap_next(&ctx->free_map, 0);
+    while(head != NULL_BLOCK && n < count) {
+      size_t len = bitmap_next_clear(&ctx->free_map, head) - head;
+      if(len < block_nb) {
+        head = bitmap_next(&ctx->free_map, head + len);
+        continue;
+      }
+      size_t nb = len / block_nb < count - n ? len / block_nb : count - n;
+      take_at(ctx, head, nb * block_nb); // the rest of the run stays untouched
+      for(size_t i = 0; i < nb; i++, n++) {
+        int first = head + i * block_nb;
+        ctx->blocks[first] = block_nb*8;
+        bitmap_assign(&ctx->header_map, first, 1, 1);
+        out[n] = first+1;
+      }
+      head = bitmap_next(&ctx->free_map, head + len);
+    }
+  }
+  for(size_t i = 0; i < n; i++) {
+    zero_blocks(ctx, out[i], size);
+  }
+  if(n == count) {
+    ctx->error_no = E_SUCCESS;
+  }else{
+    ctx->error_no = block_nb > ctx->available_blocks ? E_NOMEM : E_SHOULD_PACK;
+  }
+  return n;
+}
+
+void memory_ctx_lifelike_free(struct memory_alloc_t *ctx, int addr) {
+#ifdef MEMORY_THREAD_SAFE
+  if(cache_free(ctx, addr)) {
+    return;
+  }
+#endif
+  MEMORY_GUARD(ctx);
+  size_t block_nb = ctx->blocks[addr-1]/8;
+  bitmap_assign(&ctx->header_map, addr-1, 1, 0);
+  give_blocks(ctx, addr-1, block_nb);
+  ctx->error_no = E_SUCCESS;
+}
+
+static int compare_addr(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+/* Merge the areas adjacent once sorted into runs, given back one at a
+ * time. An unsorted list only gets its free blocks bitmap updated, and
+ * is then relinked by a single sweep. Cached areas skip the cache.
+ */
+void memory_ctx_lifelike_free_bulk(struct memory_alloc_t *ctx, int *addrs, size_t n) {
+  MEMORY_GUARD(ctx);
+  qsort(addrs, n, sizeof(int), compare_addr);
+  int relink = ctx->engine == MEMORY_LIST && !ctx->sorted;
+  for(size_t i = 0; i < n; ) {
+    int first = addrs[i] - 1;
+    size_t len = 0;
+    do { // buddies must be given back as they were taken
+      len += ctx->blocks[addrs[i]-1]/8;
+      bitmap_assign(&ctx->header_map, addrs[i]-1, 1, 0);
+      i++;
+    } while(i < n && ctx->engine != MEMORY_BUDDY && addrs[i]-1 == first + (int)len);
+    if(relink) { // the list engine keeps no zero_map
+      bitmap_assign(&ctx->free_map, first, len, 1);
+      ctx->available_blocks += len;
+    }else{
+      give_blocks(ctx, first, len);
+    }
+  }
+  if(relink) {
+    rebuild_free_lists(ctx);
+  }
+  ctx->error_no = E_SUCCESS;
+}
+
+/* Grow the lifelike area of cur_block_nb blocks starting at first (its
+ * header) to block_nb blocks, using the extents right after it and,
+ * if needed, right before it. In the latter case the area is moved to
+ * the left. The list must be sorted.
+ * Return the new first block of the area, NULL_BLOCK if the extents
+ * around it are too small.
+ */
+static int coalesce_area(struct memory_alloc_t *ctx, int first, size_t cur_block_nb, size_t block_nb) {
+  int end = first + cur_block_nb;
+  size_t right_len = 0;
+  size_t left_len = 0;
+  if(end < ctx->nb_blocks && bitmap_get(&ctx->free_map, end)) {
+    right_len = ctx->extent_len[end];
+  }
+  if(first > 0 && bitmap_get(&ctx->free_map, first-1)) {
+    left_len = ctx->extent_len[first-1];
+  }
+  if(left_len + cur_block_nb + right_len < block_nb) {
+    return NULL_BLOCK;
+  }
+  size_t right_take = block_nb - cur_block_nb < right_len ? block_nb - cur_block_nb : right_len;
+  size_t left_take = block_nb - cur_block_nb - right_take;
+  if(right_take > 0) {
+    unlink_blocks(ctx, bitmap_prev(&ctx->free_map, end), end, right_take);
+  }
+  if(left_take == 0) {
+    return first;
+  }
+  int left_head = first - left_len;
+  int new_first = first - left_take;
+  int next = ctx->blocks[first-1];
+  extent_remove(ctx, left_head);
+  if(left_take == left_len) { // the whole extent on the left is used
+    int prev = bitmap_prev(&ctx->free_map, left_head);
+    if(prev == NULL_BLOCK) {
+      ctx->first_block = next;
+    }else{
+      ctx->blocks[prev] = next;
+    }
+  }else{
+    ctx->blocks[new_first-1] = next;
+    extent_insert(ctx, left_head, left_len - left_take);
+  }
+  bitmap_assign(&ctx->free_map, new_first, left_take, 0);
+  ctx->available_blocks -= left_take;
+  memmove(&ctx->blocks[new_first], &ctx->blocks[first], cur_block_nb * sizeof(memory_page_t));
+  return new_first;
+}
+
+int memory_ctx_lifelike_realloc(struct memory_alloc_t *ctx, int addr, size_t size){
+  MEMORY_GUARD(ctx);
+  if(size == 0) { // behave like free
+    memory_ctx_lifelike_free(ctx, addr);
+    ctx->error_no = E_SUCCESS;
+    return addr;
+  }
+  if(addr == NULL_BLOCK) { // behave like malloc
+    ctx->error_no = E_SUCCESS;
+    return memory_ctx_lifelike_malloc(ctx, size);
+  }
+
+  int block_nb_needed = size/8 + 1; // add one block to store the size
+  if(size % 8 != 0) block_nb_needed++;
+  block_nb_needed = engine_block_nb(ctx, block_nb_needed);
+  int cur_block_nb = (ctx->blocks[addr-1] & ~(memory_page_t)MEMORY_CACHED)/8;
+  if(block_nb_needed == cur_block_nb) {
+    ctx->error_no = E_SUCCESS;
+    return addr; // same size do nothing, a cached area stays cached
+  }else if(block_nb_needed < cur_block_nb){ // new size < cur size
+    int nb_blocks_del = cur_block_nb - block_nb_needed;
+    ctx->blocks[addr-1] = block_nb_needed*8;
+    if(ctx->engine == MEMORY_BUDDY) { // give back the upper halves one by one
+      for(int half = (block_nb_needed+nb_blocks_del)/2; half >= block_nb_needed; half /= 2) {
+        give_blocks(ctx, addr-1+half, half);
+      }
+    }else{
+      give_blocks(ctx, addr+block_nb_needed-1, nb_blocks_del);
+    }
+    ctx->error_no = E_SUCCESS;
+    return addr;
+  }else { // new size > cur size
+    int next_block = addr-1+cur_block_nb;
+    if(ctx->engine == MEMORY_BITMAP) { // grow in place when the blocks after cur area are available
+      if(next_block < ctx->nb_blocks && bitmap_get(&ctx->free_map, next_block)
+         && bitmap_next_clear(&ctx->free_map, next_block) - next_block >= block_nb_needed-cur_block_nb) {
+        bitmap_take_at(ctx, next_block, block_nb_needed-cur_block_nb);
+        ctx->blocks[addr-1] = block_nb_needed*8;
+        ctx->error_no = E_SUCCESS;
+        return addr;
+      }
+    }else if(ctx->engine == MEMORY_TLSF) { // grow in place into the extent after cur area
+      if(next_block < ctx->nb_blocks && bitmap_get(&ctx->free_map, next_block)
+         && ctx->extent_len[next_block] >= block_nb_needed-cur_block_nb) {
+        size_t len = ctx->extent_len[next_block];
+        tlsf_remove(ctx, next_block);
+        if(len > block_nb_needed-cur_block_nb) {
+          tlsf_insert(ctx, addr-1+block_nb_needed, len - (block_nb_needed-cur_block_nb));
+        }
+        bitmap_take_at(ctx, next_block, block_nb_needed-cur_block_nb);
+        ctx->blocks[addr-1] = block_nb_needed*8;
+        ctx->error_no = E_SUCCESS;
+        return addr;
+      }
+    }else if(ctx->engine == MEMORY_LIST) { // a buddy area always moves
+      if(ctx->sorted) { // merge with the extents around cur area
+        int first = coalesce_area(ctx, addr-1, cur_block_nb, block_nb_needed);
+        if(first != NULL_BLOCK) {
+          ctx->blocks[first] = block_nb_needed*8;
+          if(bitmap_get(&ctx->header_map, addr-1)) { // the area may be moved by memory_ctx_pack()
+            bitmap_assign(&ctx->header_map, addr-1, 1, 0);
+            bitmap_assign(&ctx->header_map, first, 1, 1);
+          }
+          ctx->error_no = E_SUCCESS;
+          return first+1;
+        }
+      }else{
+        if(next_block < ctx->nb_blocks // cur area does not end the heap
+           && bitmap_get(&ctx->free_map, next_block) // the block after cur area is available
+           && memory_ctx_nb_consecutive_blocks(ctx, next_block) >= block_nb_needed-cur_block_nb) { // enough space next to cur
+          int prev = find_prev_block(ctx, next_block);
+          unlink_blocks(ctx, prev, next_block, block_nb_needed-cur_block_nb);
+          ctx->blocks[addr-1] = block_nb_needed*8;
+          ctx->error_no = E_SUCCESS;
+          return addr;
+        }
+      }
+    }
+    // not enough space around cur area: move it. It stays untouched on failure
+    int new_addr = lifelike_malloc(ctx, (block_nb_needed-1)*8, 0); // overwritten below
+    if(new_addr == NULL_BLOCK) {
+      if(block_nb_needed <= ctx->available_blocks + cur_block_nb) { // packing may free enough blocks
+        ctx->error_no = E_SHOULD_PACK;
+      }
+      return NULL_BLOCK;
+    }
+    memcpy(&ctx->blocks[new_addr], &ctx->blocks[addr], (cur_block_nb-1) * sizeof(memory_page_t));
+    memory_ctx_lifelike_free(ctx, addr);
+    return new_addr;
+  }
+}
+
+/* Look for addr among the old addresses of the relocations, by dichotomy */
+int memory_relocated(const struct memory_relocation *relocations, size_t nb_relocations, int addr) {
+  size_t low = 0;
+  size_t high = nb_relocations;
+  while(low < high) {
+    size_t middle = (low + high) / 2;
+    if(relocations[middle].old_addr < addr) {
+      low = middle + 1;
+    }else{
+      high = middle;
+    }
+  }
+  if(low < nb_relocations && relocations[low].old_addr == addr) {
+    return relocations[low].new_addr;
+  }
+  return addr;
+}
+
+/* Return the entry of handle in the handle table */
+static int *handle_slot(struct memory_alloc_t *ctx, size_t handle) {
+  return &ctx->handles[handle / MEMORY_HANDLE_CHUNK][handle % MEMORY_HANDLE_CHUNK];
+}
+
+/* Update the handle of the area moved from block old_first to block
+ * new_first, if a handle refers to it
+ */
+static void handle_moved(struct memory_alloc_t *ctx, size_t old_first, size_t new_first) {
+  if(ctx->area_handles == NULL) {
+    return;
+  }
+  int handle = ctx->area_handles[old_first];
+  if((size_t)handle < ctx->nb_handles && *handle_slot(ctx, handle) == (int)old_first+1) {
+    *handle_slot(ctx, handle) = new_first+1;
+    ctx->area_handles[new_first] = handle;
+  }
+}
+
+/* Slide the lifelike areas towards the start of the heap. Walking the
+ * allocated blocks in address order, each lifelike area (found with
+ * header_map, its length being in its header) is moved right after the
+ * previous one. Any other allocated block stays in place and the next
+ * area goes after it. The gaps left behind become the free runs.
+ */
+void memory_ctx_pack(struct memory_alloc_t *ctx, struct memory_relocation **relocations,
+                     size_t *nb_relocations) {
+  MEMORY_GUARD(ctx);
+  drain_remote_frees(ctx); // their headers hold links
+  struct memory_relocation *moved = NULL;
+  size_t nb_moved = 0;
+  if(relocations != NULL) { *relocations = NULL; }
+  if(nb_relocations != NULL) { *nb_relocations = 0; }
+  if(ctx->engine == MEMORY_BUDDY) { // buddy blocks must stay aligned
+    ctx->error_no = E_SUCCESS;
+    return;
+  }
+  size_t nb_areas = bitmap_count(&ctx->header_map);
+  if(relocations != NULL && nb_areas > 0) {
+    moved = malloc(nb_areas * sizeof(struct memory_relocation));
+    if(moved == NULL) {
+      ctx->error_no = E_NOMEM;
+      return;
+    }
+  }
+  size_t n = ctx->nb_blocks;
+  int first_free = bitmap_next(&ctx->free_map, 0);
+  size_t dst = first_free == NULL_BLOCK ? n : (size_t)first_free;
+  size_t i = bitmap_next_clear(&ctx->free_map, dst);
+  // below dst the blocks are packed, from i on they are untouched
+  while(i < n) {
+    size_t len = 1;
+    if(bitmap_get(&ctx->header_map, i)) {
+      len = ctx->blocks[i]/8;
+      if(dst < i) {
+        memmove(&ctx->blocks[dst], &ctx->blocks[i], len * sizeof(memory_page_t));
+        bitmap_assign(&ctx->header_map, i, 1, 0);
+        bitmap_assign(&ctx->header_map, dst, 1, 1);
+        bitmap_assign(&ctx->free_map, dst, len, 0);
+        bitmap_assign(&ctx->zero_map, i, len, 0); // the blocks left behind may be available
+        handle_moved(ctx, i, dst);
+        if(moved != NULL) {
+          moved[nb_moved].old_addr = i+1;
+          moved[nb_moved].new_addr = dst+1;
+        }
+        nb_moved++;
+      }
+      dst += len;
+    }else{ // a block of memory_ctx_allocate(), which cannot move
+      bitmap_assign(&ctx->free_map, dst, i - dst, 1);
+      dst = i+1;
+    }
+    i = bitmap_next_clear(&ctx->free_map, i + len);
+  }
+  bitmap_assign(&ctx->free_map, dst, n - dst, 1);
+  rebuild_free_lists(ctx);
+  if(nb_relocations != NULL) {
+    *nb_relocations = nb_moved;
+  }
+  if(relocations != NULL && nb_moved > 0) {
+    *relocations = moved;
+  }else{
+    free(moved);
+  }
+  ctx->error_no = E_SUCCESS;
+}
+
+/* Each step looks for the first run of available blocks from
+ * defrag_pos. The lifelike area right after it is moved at its start,
+ * with take_extent() and give_blocks(), so that the run merges with the
+ * one after the area, and its handle follows it through area_handles.
+ * A block of memory_ctx_allocate() is skipped.
+ */
+void memory_ctx_defrag_step(struct memory_alloc_t *ctx, size_t budget,
+                            struct memory_relocation **relocations, size_t *nb_relocations,
+                            struct memory_defrag_stats *stats) {
+  MEMORY_GUARD(ctx);
+  drain_remote_frees(ctx);
+  struct memory_relocation *moved = NULL;
+  size_t nb_moved = 0;
+  size_t moved_capacity = 0;
+  size_t moved_blocks = 0;
+  size_t cost = 0;
+  int done = 0;
+  if(relocations != NULL) { *relocations = NULL; }
+  if(nb_relocations != NULL) { *nb_relocations = 0; }
+  if(ctx->engine == MEMORY_LIST && !ctx->sorted) {
+    memory_ctx_reorder(ctx);
+    cost = ctx->available_blocks;
+  }
+  while(ctx->engine != MEMORY_BUDDY && cost < budget) {
+    int dst = bitmap_next(&ctx->free_map, ctx->defrag_pos);
+    size_t i = dst == NULL_BLOCK ? ctx->nb_blocks : bitmap_next_clear(&ctx->free_map, dst);
+    if(i >= ctx->nb_blocks) { // the available blocks are at the end
+      ctx->defrag_pos = 0;
+      done = 1;
+      break;
+    }
+    if(!bitmap_get(&ctx->header_map, i)) {
+      ctx->defrag_pos = i+1;
+      cost++;
+      continue;
+    }
+    if(!is_extent_head(ctx, dst)) { // the run grew to the left since the last step
+      dst = ctx->engine == MEMORY_BITMAP ? (int)bitmap_run_start(&ctx->free_map, i) : i - ctx->extent_len[i-1];
+    }
+    size_t len = ctx->blocks[i]/8;
+    if(cost > 0 && cost + len > budget) {
+      break;
+    }
+    if(relocations != NULL) {
+      if(nb_moved == moved_capacity) {
+        moved_capacity = moved_capacity > 0 ? 2 * moved_capacity : 16;
+        struct memory_relocation *grown = realloc(moved, moved_capacity * sizeof(struct memory_relocation));
+        if(grown == NULL) {
+          free(moved);
+          ctx->error_no = E_NOMEM;
+          return;
+        }
+        moved = grown;
+      }
+      moved[nb_moved].old_addr = i+1;
+      moved[nb_moved].new_addr = dst+1;
+    }
+    nb_moved++;
+    size_t gap = take_extent(ctx, dst);
+    memmove(&ctx->blocks[dst], &ctx->blocks[i], len * sizeof(memory_page_t));
+    bitmap_assign(&ctx->header_map, i, 1, 0);
+    bitmap_assign(&ctx->header_map, dst, 1, 1);
+    give_blocks(ctx, dst + len, gap);
+    handle_moved(ctx, i, dst);
+    ctx->defrag_pos = dst + len;
+    moved_blocks += len;
+    cost += len;
+  }
+  if(nb_relocations != NULL) {
+    *nb_relocations = nb_moved;
+  }
+  if(relocations != NULL && nb_moved > 0) {
+    *relocations = moved;
+  }else{
+    free(moved);
+  }
+  if(stats != NULL) {
+    stats->moved_blocks = moved_blocks;
+    stats->done = done || ctx->engine == MEMORY_BUDDY;
+  }
+  ctx->error_no = E_SUCCESS;
+}
+
+void memory_ctx_fragmentation(struct memory_alloc_t *ctx, struct memory_fragmentation *fragmentation) {
+  MEMORY_GUARD(ctx);
+  drain_remote_frees(ctx);
+  fragmentation->largest_run = 0;
+  fragmentation->nb_extents = 0;
+  for(int head = bitmap_next(&ctx->free_map, 0); head != NULL_BLOCK; ) {
+    size_t end = bitmap_next_clear(&ctx->free_map, head);
+    if(end - head > fragmentation->largest_run) { fragmentation->largest_run = end - head; }
+    fragmentation->nb_extents++;
+    head = bitmap_next(&ctx->free_map, end);
+  }
+}
+
+/* Take a handle from the released ones, or from the end of the table
+ * (adding a chunk to it when full). Return NULL_BLOCK if the table
+ * cannot grow.
+ */
+static int handle_take(struct memory_alloc_t *ctx) {
+  if(ctx->nb_free_handles > 0) {
+    return ctx->free_handles[--ctx->nb_free_handles];
+  }
+  if(ctx->nb_handles == ctx->handles_capacity) {
+    if(ctx->handles == NULL) {
+      size_t nb_chunks = (ctx->nb_blocks + MEMORY_HANDLE_CHUNK - 1) / MEMORY_HANDLE_CHUNK;
+      ctx->handles = calloc(nb_chunks > 0 ? nb_chunks : 1, sizeof(int *));
+      ctx->area_handles = calloc(ctx->nb_blocks > 0 ? ctx->nb_blocks : 1, sizeof(int));
+      if(ctx->handles == NULL || ctx->area_handles == NULL) {
+        free(ctx->handles);
+        free(ctx->area_handles);
+        ctx->handles = NULL;
+        ctx->area_handles = NULL;
+        return NULL_BLOCK;
+      }
+    }
+    if(ctx->handles_capacity >= ctx->nb_blocks) { // no more handles than blocks
+      return NULL_BLOCK;
+    }
+    size_t capacity = ctx->handles_capacity + MEMORY_HANDLE_CHUNK;
+    int *free_handles = realloc(ctx->free_handles, capacity * sizeof(int));
+    if(free_handles == NULL) {
+      return NULL_BLOCK;
+    }
+    ctx->free_handles = free_handles;
+    int *chunk = malloc(MEMORY_HANDLE_CHUNK * sizeof(int));
+    if(chunk == NULL) {
+      return NULL_BLOCK;
+    }
+    ctx->handles[ctx->handles_capacity / MEMORY_HANDLE_CHUNK] = chunk;
+    ctx->handles_capacity = capacity;
+  }
+  *handle_slot(ctx, ctx->nb_handles) = NULL_BLOCK;
+  return ctx->nb_handles++;
+}
+
+/* Put handle back on the stack of released handles */
+static void handle_give(struct memory_alloc_t *ctx, int handle) {
+  *handle_slot(ctx, handle) = NULL_BLOCK;
+  ctx->free_handles[ctx->nb_free_handles++] = handle;
+}
+
+int memory_ctx_handle_malloc(struct memory_alloc_t *ctx, size_t size) {
+  MEMORY_GUARD(ctx);
+  int handle = handle_take(ctx);
+  if(handle == NULL_BLOCK) {
+    ctx->error_no = E_NOMEM;
+    return NULL_BLOCK;
+  }
+  int addr = memory_ctx_lifelike_malloc(ctx, size);
+  if(addr == NULL_BLOCK) {
+    handle_give(ctx, handle);
+    return NULL_BLOCK;
+  }
+  *handle_slot(ctx, handle) = addr;
+  ctx->area_handles[addr-1] = handle;
+  return handle;
+}
+
+void memory_ctx_handle_free(struct memory_alloc_t *ctx, int handle) {
+  MEMORY_GUARD(ctx);
+  memory_ctx_lifelike_free(ctx, memory_ctx_resolve(ctx, handle));
+  handle_give(ctx, handle);
+}
+
+int memory_ctx_handle_realloc(struct memory_alloc_t *ctx, int handle, size_t size) {
+  MEMORY_GUARD(ctx);
+  int addr = memory_ctx_lifelike_realloc(ctx, memory_ctx_resolve(ctx, handle), size);
+  if(size == 0) {
+    handle_give(ctx, handle);
+    return NULL_BLOCK;
+  }
+  if(addr == NULL_BLOCK) {
+    return NULL_BLOCK;
+  }
+  *handle_slot(ctx, handle) = addr;
+  ctx->area_handles[addr-1] = handle;
+  return handle;
+}
+
+void memory_ctx_pool_init(struct memory_alloc_t *ctx, struct memory_pool *pool,
+                          size_t slot_size, size_t nb_slots) {
+  pool->blocks = ctx->blocks;
+  pool->slot_blocks = slot_size > 8 ? (slot_size + 7) / 8 : 1;
+  pool->nb_slots = nb_slots;
+  pool->head = NULL_BLOCK;
+  pool->first = NULL_BLOCK;
+  if(nb_slots == 0 || nb_slots > MAX_SIZE / pool->slot_blocks) {
+    ctx->error_no = E_NOMEM;
+    return;
+  }
+  pool->first = memory_ctx_allocate(ctx, nb_slots * pool->slot_blocks * 8);
+  if(pool->first == NULL_BLOCK) {
+    return;
+  }
+  for(size_t slot = 0; slot + 1 < nb_slots; slot++) {
+    pool->blocks[pool->first + slot * pool->slot_blocks] = pool->first + (slot+1) * pool->slot_blocks;
+  }
+  pool->blocks[pool->first + (nb_slots-1) * pool->slot_blocks] = NULL_BLOCK;
+  pool->head = pool->first;
+}
+
+void memory_ctx_pool_destroy(struct memory_alloc_t *ctx, struct memory_pool *pool) {
+  if(pool->first != NULL_BLOCK) {
+    memory_ctx_free(ctx, pool->first, pool->nb_slots * pool->slot_blocks * 8);
+  }
+  pool->first = NULL_BLOCK;
+  pool->head = NULL_BLOCK;
+}
+
+/* Pop the first free slot. Another thread may pop it, and write in it,
+ * between the read of its link and the compare-and-swap: the tag of the
+ * head then differs and the pop is retried.
+ */
+int memory_pool_alloc(struct memory_pool *pool) {
+  uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+  uint64_t next_head;
+  do {
+    int first = (uint32_t)head;
+    if(first == NULL_BLOCK) {
+      return NULL_BLOCK;
+    }
+    uint32_t next = __atomic_load_n(&pool->blocks[first], __ATOMIC_RELAXED);
+    next_head = ((head >> 32) + 1) << 32 | next;
+  } while(!__atomic_compare_exchange_n(&pool->head, &head, next_head, 1,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+  return (uint32_t)head;
+}
+
+/* Push the slot at addr, linked to the current first free slot */
+void memory_pool_free(struct memory_pool *pool, int addr) {
+  uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+  uint64_t new_head;
+  do {
+    __atomic_store_n(&pool->blocks[addr], (uint32_t)head, __ATOMIC_RELAXED);
+    new_head = ((head >> 32) + 1) << 32 | (uint32_t)addr;
+  } while(!__atomic_compare_exchange_n(&pool->head, &head, new_head, 1,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void memory_arenas_init(struct memory_arenas *arenas, size_t nb_arenas, size_t nb_blocks,
+                        const struct memory_options *options) {
+  arenas->nb_arenas = 0;
+  arenas->arena_blocks = nb_arenas > 0 ? nb_blocks / nb_arenas : 0;
+  arenas->blocks = NULL;
+  arenas->arenas = NULL;
+  if(arenas->arena_blocks == 0 || nb_blocks > MAX_SIZE) {
+    return;
+  }
+  arenas->blocks = malloc(nb_blocks * sizeof(memory_page_t));
+  // each arena starts a cache line: sizeof(struct memory_alloc_t) is a multiple of it
+  arenas->arenas = aligned_alloc(MEMORY_CACHE_LINE, nb_arenas * sizeof(struct memory_alloc_t));
+  if(arenas->blocks == NULL || arenas->arenas == NULL) {
+    memory_arenas_destroy(arenas);
+    return;
+  }
+  for(size_t k = 0; k < nb_arenas; k++) {
+    size_t first = k * arenas->arena_blocks;
+    size_t nb = k + 1 < nb_arenas ? arenas->arena_blocks : nb_blocks - first;
+    memory_ctx_init_with(&arenas->arenas[k], arenas->blocks + first, nb, options);
+    arenas->nb_arenas++;
+    if(arenas->arenas[k].error_no != E_SUCCESS) {
+      memory_arenas_destroy(arenas);
+      return;
+    }
+  }
+}
+
+void memory_arenas_destroy(struct memory_arenas *arenas) {
+  for(size_t k = 0; k < arenas->nb_arenas; k++) {
+    memory_ctx_destroy(&arenas->arenas[k]);
+  }
+  free(arenas->arenas);
+  free(arenas->blocks);
+  arenas->arenas = NULL;
+  arenas->blocks = NULL;
+  arenas->nb_arenas = 0;
+}
+
+/* arena of the calling thread, assigned at its first allocation */
+static _Thread_local size_t arena_home = SIZE_MAX;
+static size_t arena_next;
+
+/* Return the index of the first arena to allocate from */
+static size_t arenas_home(const struct memory_arenas *arenas) {
+  if(arena_home == SIZE_MAX) {
+    arena_home = __atomic_fetch_add(&arena_next, 1, __ATOMIC_RELAXED);
+  }
+  return arena_home % arenas->nb_arenas;
+}
+
+/* Return the index of the arena owning the block addr */
+static size_t arenas_owner(const struct memory_arenas *arenas, int addr) {
+  size_t k = addr / arenas->arena_blocks;
+  return k < arenas->nb_arenas ? k : arenas->nb_arenas - 1;
+}
+
+int memory_arenas_allocate(struct memory_arenas *arenas, size_t size) {
+  if(arenas->nb_arenas == 0) { // memory_arenas_init() failed
+    return NULL_BLOCK;
+  }
+  size_t home = arenas_home(arenas);
+  for(size_t i = 0; i < arenas->nb_arenas; i++) { // then the next arenas
+    size_t k = (home + i) % arenas->nb_arenas;
+    int addr = memory_ctx_allocate(&arenas->arenas[k], size);
+    if(addr != NULL_BLOCK) {
+      return k * arenas->arena_blocks + addr;
+    }
+  }
+  return NULL_BLOCK;
+}
+
+void memory_arenas_free(struct memory_arenas *arenas, int addr, size_t size) {
+  if(arenas->nb_arenas == 0) {
+    return;
+  }
+  size_t k = arenas_owner(arenas, addr);
+  memory_ctx_free(&arenas->arenas[k], addr - k * arenas->arena_blocks, size);
+}
+
+int memory_arenas_lifelike_malloc(struct memory_arenas *arenas, size_t size) {
+  if(arenas->nb_arenas == 0) {
+    return NULL_BLOCK;
+  }
+  size_t home = arenas_home(arenas);
+  for(size_t i = 0; i < arenas->nb_arenas; i++) {
+    size_t k = (home + i) % arenas->nb_arenas;
+    int addr = memory_ctx_lifelike_malloc(&arenas->arenas[k], size);
+    if(addr != NULL_BLOCK) {
+      return k * arenas->arena_blocks + addr;
+    }
+  }
+  return NULL_BLOCK;
+}
+
+void memory_arenas_lifelike_free(struct memory_arenas *arenas, int addr) {
+  if(arenas->nb_arenas == 0) {
+    return;
+  }
+  size_t k = arenas_owner(arenas, addr);
+  if(k != arenas_home(arenas)) { // another thread allocates from it
+    memory_ctx_remote_free(&arenas->arenas[k], addr - k * arenas->arena_blocks);
+  }else{
+    memory_ctx_lifelike_free(&arenas->arenas[k], addr - k * arenas->arena_blocks);
+  }
+}
+
+/* print the message corresponding to error_number */
+void memory_error_print(enum memory_errno error_number) {
+  switch(error_number) {
+  case E_SUCCESS:
+    printf("Success\n");
+    break;
+  case E_NOMEM:
+    printf("Not enough memory\n");
+    break;
+  case  E_SHOULD_PACK:
+    printf("Not enough contiguous blocks\n");
+    break;
+  default:
+    printf("Unknown\n");
+    break;
+  }
+}
+
+/* Initialize an allocated buffer with zeros */
+void memory_ctx_initialize_buffer(struct memory_alloc_t *ctx, int start_index, size_t size) {
+  char* ptr = (char*)&ctx->blocks[start_index];
+  for(size_t i=0; i<size; i++) {
+    ptr[i]=0;
+  }
+}
+
+/*************************************************/
+/*       Entry points on the default heap m      */
+/*************************************************/
+
+void memory_init(size_t nb_blocks) {
+  memory_ctx_destroy(&m);
+  memory_ctx_init(&m, nb_blocks);
+}
+
+void memory_init_region(memory_page_t *region, size_t nb_blocks) {
+  memory_ctx_destroy(&m);
+  memory_ctx_init_region(&m, region, nb_blocks);
+}
+
+void memory_init_with(memory_page_t *region, size_t nb_blocks, const struct memory_options *options) {
+  memory_ctx_destroy(&m);
+  memory_ctx_init_with(&m, region, nb_blocks, options);
+}
+
+void memory_destroy() {
+  memory_ctx_destroy(&m);
+}
+
+void memory_sync() {
+  memory_ctx_sync(&m);
+}
+
+int nb_consecutive_blocks(int first) {
+  return memory_ctx_nb_consecutive_blocks(&m, first);
+}
+
+void memory_reorder() {
+  memory_ctx_reorder(&m);
+}
+
+void memory_print() {
+  memory_ctx_print(&m);
+}
+
+int memory_allocate(size_t size) {
+  return memory_ctx_allocate(&m, size);
+}
+
+int memory_allocate_nozero(size_t size) {
+  return memory_ctx_allocate_nozero(&m, size);
+}
+
+void memory_free(int addr, size_t size) {
+  memory_ctx_free(&m, addr, size);
+}
+
+void initialize_buffer(int start_index, size_t size) {
+  memory_ctx_initialize_buffer(&m, start_index, size);
+}
+
+int memory_lifelike_malloc(size_t size) {
+  return memory_ctx_lifelike_malloc(&m, size);
+}
+
+int memory_lifelike_malloc_nozero(size_t size) {
+  return memory_ctx_lifelike_malloc_nozero(&m, size);
+}
+
+int memory_lifelike_calloc(size_t nmemb, size_t size) {
+  return memory_ctx_lifelike_calloc(&m, nmemb, size);
+}
+
+void memory_lifelike_free(int addr) {
+  memory_ctx_lifelike_free(&m, addr);
+}
+
+size_t memory_lifelike_malloc_batch(size_t size, size_t count, int *out) {
+  return memory_ctx_lifelike_malloc_batch(&m, size, count, out);
+}
+
+void memory_lifelike_free_bulk(int *addrs, size_t n) {
+  memory_ctx_lifelike_free_bulk(&m, addrs, n);
+}
+
+int memory_lifelike_realloc(int addr, size_t size) {
+  return memory_ctx_lifelike_realloc(&m, addr, size);
+}
+
+void memory_pack(struct memory_relocation **relocations, size_t *nb_relocations) {
+  memory_ctx_pack(&m, relocations, nb_relocations);
+}
+
+void memory_defrag_step(size_t budget, struct memory_relocation **relocations,
+                        size_t *nb_relocations, struct memory_defrag_stats *stats) {
+  memory_ctx_defrag_step(&m, budget, relocations, nb_relocations, stats);
+}
+
+void memory_fragmentation(struct memory_fragmentation *fragmentation) {
+  memory_ctx_fragmentation(&m, fragmentation);
+}
+
+void memory_pool_init(struct memory_pool *pool, size_t slot_size, size_t nb_slots) {
+  memory_ctx_pool_init(&m, pool, slot_size, nb_slots);
+}
+
+void memory_pool_destroy(struct memory_pool *pool) {
+  memory_ctx_pool_destroy(&m, pool);
+}
+
+void memory_cache_flush() {
+  memory_ctx_cache_flush(&m);
+}
+
+int memory_handle_malloc(size_t size) {
+  return memory_ctx_handle_malloc(&m, size);
+}
+
+void memory_handle_free(int handle) {
+  memory_ctx_handle_free(&m, handle);
+}
+
+int memory_handle_realloc(int handle, size_t size) {
+  return memory_ctx_handle_realloc(&m, handle, size);
 }
 
-/* Allocate size bytes
- * return NULL_BLOCK in case of an error
+/*************************************************/
+/*                  Benchmarks                   */
+/*************************************************/
+
+/* size of the heap, number of areas alive at most and number of
+ * operations of a benchmark run
  */
-int memory_allocate(size_t size) {
-  
-  int index = m.first_block;
-  int block_nb_needed = size / 8;
-  if(size % 8 != 0) { block_nb_needed++; }
-  if(nb_consecutive_blocks(index) < block_nb_needed){ // case where the needed nb of blocks is not available on first block
-    while(nb_consecutive_blocks(m.blocks[index]) < block_nb_needed){
-      index = m.blocks[index];
-      if(m.blocks[index] == NULL_BLOCK){
-        memory_reorder();
-        index = m.first_block;
-        while(nb_consecutive_blocks(m.blocks[index]) < block_nb_needed){ // we check again after memory reorder
-          index = m.blocks[index];
-          if(m.blocks[index] == NULL_BLOCK){
-            m.error_no = E_SHOULD_PACK;
-            return NULL_BLOCK;
-          }
-        }
-        break; // jump out of the while
-      }
-    }
-    int first_block = m.blocks[index];
-    m.blocks[index] = m.blocks[first_block + block_nb_needed-1];
-    initialize_buffer(first_block, size);
-    m.available_blocks-=block_nb_needed;
-    m.error_no = E_SUCCESS;
-    return first_block;
-  }else{ // case where the needed nb of blocks is available on first block
-    m.available_blocks-=block_nb_needed;
-    m.error_no = E_SUCCESS;
-    m.first_block = m.blocks[index + block_nb_needed-1];
-    initialize_buffer(index, size);
-    return index;
-  }
+#define BENCH_BLOCKS (1 << 15)
+#define BENCH_SLOTS 2048
+#define BENCH_OPS 1000000
+
+/* state of the pseudo-random generator of the benchmarks (xorshift) */
+static uint64_t bench_seed;
+
+static uint64_t bench_random() {
+  bench_seed ^= bench_seed << 13;
+  bench_seed ^= bench_seed >> 7;
+  bench_seed ^= bench_seed << 17;
+  return bench_seed;
 }
 
-/* Free the block of data starting at address */
-void memory_free(int address, size_t size) {
-  int block_nb = size / 8;
-  if(size % 8 != 0) { block_nb++; }
-  for (int i = address; i < address+block_nb; i++)
-  {
-    m.blocks[i] = i+1;
-  }
-  m.blocks[address+block_nb-1] = m.first_block;
-  m.first_block = address;
-  m.available_blocks += block_nb;
-  m.error_no = E_SUCCESS;
-  
+/* Return a size in bytes of the mixed workload: mostly small areas,
+ * some medium ones and a few large ones
+ */
+static size_t bench_size() {
+  uint64_t r = bench_random() % 100;
+  if(r < 70) { return 8 * (1 + bench_random() % 8); }
+  if(r < 95) { return 8 * (9 + bench_random() % 56); }
+  return 8 * (65 + bench_random() % 448);
 }
 
-/* Print information on the available blocks of the memory allocator */
-void memory_print() {
-  printf("---------------------------------\n");
-  printf("\tBlock size: %lu\n", sizeof(m.blocks[0]));
-  printf("\tAvailable blocks: %lu\n", m.available_blocks);
-  printf("\tFirst free: %d\n", m.first_block);
-  printf("\tError_no: "); memory_error_print(m.error_no);
-  printf("\tContent:  ");
-
-  int address = m.first_block;
-  printf("[%d]", address);
-  while(m.blocks[address] != NULL_BLOCK) {
-    printf(" -> [%ld]", m.blocks[address]);
-    address = m.blocks[address];
+/* an operation of a trace: slot gets an area of size bytes if alloc is
+ * non-zero, otherwise the area of slot is freed
+ */
+struct bench_op {
+  int slot;
+  int alloc;
+  size_t size;
+};
+
+/* trace replayed by the benchmarks */
+static struct bench_op *bench_ops;
+static size_t bench_nb_ops;
+static int bench_nb_slots;
+
+/* Build the trace of the mixed workload: BENCH_OPS operations on random
+ * slots among BENCH_SLOTS, a slot being freed when it holds an area
+ */
+static void bench_mixed_trace() {
+  static char live[BENCH_SLOTS];
+  bench_ops = malloc(BENCH_OPS * sizeof(struct bench_op));
+  bench_nb_ops = BENCH_OPS;
+  bench_nb_slots = BENCH_SLOTS;
+  bench_seed = 88172645463325252ULL;
+  for(int op = 0; op < BENCH_OPS; op++) {
+    int slot = bench_random() % BENCH_SLOTS;
+    bench_ops[op].slot = slot;
+    bench_ops[op].alloc = !live[slot];
+    bench_ops[op].size = live[slot] ? 0 : bench_size();
+    live[slot] = !live[slot];
   }
-  printf(" -> NULL_BLOCK");
-
-  printf("\n");
-  printf("---------------------------------\n");
 }
 
-int memory_lifelike_malloc(size_t size) {
-  // will look for size + 1 blocks
-  // will return the addr of the second block
-  int index = m.first_block;
-  int block_nb_needed = size / 8;
-  if(size % 8 != 0) block_nb_needed++;
-  block_nb_needed++; // add one block needed to store the nb of blocks
-  if(nb_consecutive_blocks(index) < block_nb_needed){ // case where the needed nb of blocks is not available on first block
-    while(nb_consecutive_blocks(m.blocks[index]) < block_nb_needed){
-      index = m.blocks[index];
-      if(m.blocks[index] == NULL_BLOCK){
-        memory_reorder();
-        index = m.first_block;
-        while(nb_consecutive_blocks(m.blocks[index]) < block_nb_needed){ // we check again after memory reorder
-          index = m.blocks[index];
-          if(m.blocks[index] == NULL_BLOCK){
-            m.error_no = E_SHOULD_PACK;
-            return NULL_BLOCK;
-          }
-        }
-        break; // jump out of the while
-      }
+/* Load a trace made of lines "a <slot> <bytes>" (allocate) and
+ * "f <slot>" (free). Return -1 if the file cannot be read.
+ */
+static int bench_load_trace(const char *path) {
+  FILE *file = fopen(path, "r");
+  if(file == NULL) { return -1; }
+  size_t capacity = 1024;
+  bench_ops = malloc(capacity * sizeof(struct bench_op));
+  bench_nb_ops = 0;
+  bench_nb_slots = 0;
+  char kind;
+  struct bench_op op = { 0, 0, 0 };
+  while(fscanf(file, " %c %d", &kind, &op.slot) == 2 && op.slot >= 0) {
+    op.alloc = kind == 'a';
+    op.size = 0;
+    if(op.alloc && fscanf(file, "%zu", &op.size) != 1) { break; }
+    if(bench_nb_ops == capacity) {
+      capacity *= 2;
+      bench_ops = realloc(bench_ops, capacity * sizeof(struct bench_op));
     }
-    int first_block = m.blocks[index];
-    m.blocks[index] = m.blocks[first_block + block_nb_needed-1];
-    m.blocks[first_block] = block_nb_needed*8; // Store the size in bytes needed
-    initialize_buffer(first_block+1, size);
-    m.available_blocks-=block_nb_needed;
-    m.error_no = E_SUCCESS;
-    return first_block+1;  
-  }else{ // case where the needed nb of blocks is available on first block
-    m.available_blocks-=block_nb_needed;
-    m.error_no = E_SUCCESS;
-    m.first_block = m.blocks[index + block_nb_needed-1];
-    m.blocks[index] = block_nb_needed-1; // Store the size in bytes needed
-    initialize_buffer(index+1, size);
-    m.error_no = E_SUCCESS;
-    return index+1;
-  }
-  m.error_no = E_SHOULD_PACK;
-  return NULL_BLOCK;
-}
-
-void memory_lifelike_free(int addr) {
-  int block_nb = m.blocks[addr-1]/8;
-  for (int i = addr-1; i < (addr-1)+block_nb-1; i++) {
-    m.blocks[i] = i+1;
+    bench_ops[bench_nb_ops++] = op;
+    if(op.slot >= bench_nb_slots) { bench_nb_slots = op.slot + 1; }
   }
-  m.blocks[(addr-1)+block_nb-1] = m.first_block;
-  m.first_block = addr-1;
-  m.available_blocks += block_nb;
-  m.error_no = E_SUCCESS;
+  fclose(file);
+  return 0;
 }
 
-int memory_lifelike_realloc(int addr, size_t size){
-  if(size == 0) { // behave like free
-    memory_lifelike_free(addr);
-    m.error_no = E_SUCCESS;
-    return addr;
+/* Replay the trace with memory_ctx_allocate() and memory_ctx_free() on a
+ * heap initialized with options. Print the throughput, the number of
+ * failed allocations and the fragmentation of the available blocks at
+ * the end (share of them outside of the largest run). Freeing an area
+ * whose allocation failed does nothing.
+ */
+static void bench_run(const char *name, const struct memory_options *options) {
+  int *addr = malloc(bench_nb_slots * sizeof(int));
+  size_t *size = malloc(bench_nb_slots * sizeof(size_t));
+  struct memory_alloc_t ctx;
+  memory_ctx_init_with(&ctx, NULL, BENCH_BLOCKS, options);
+  for(int slot = 0; slot < bench_nb_slots; slot++) {
+    addr[slot] = NULL_BLOCK;
   }
-  if(addr == NULL_BLOCK) { // behave like malloc
-    m.error_no = E_SUCCESS;
-    return memory_lifelike_malloc(size);
+  size_t failures = 0;
+  size_t allocations = 0;
+  clock_t start = clock();
+  for(size_t op = 0; op < bench_nb_ops; op++) {
+    int slot = bench_ops[op].slot;
+    if(bench_ops[op].alloc) {
+      if(addr[slot] != NULL_BLOCK) { // the trace reuses a slot without freeing it
+        memory_ctx_free(&ctx, addr[slot], size[slot]);
+      }
+      size[slot] = bench_ops[op].size;
+      addr[slot] = memory_ctx_allocate(&ctx, size[slot]);
+      allocations++;
+      if(addr[slot] == NULL_BLOCK) { failures++; }
+    }else if(addr[slot] != NULL_BLOCK) {
+      memory_ctx_free(&ctx, addr[slot], size[slot]);
+      addr[slot] = NULL_BLOCK;
+    }
   }
+  double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  struct memory_fragmentation runs;
+  memory_ctx_fragmentation(&ctx, &runs);
+  double fragmentation = ctx.available_blocks == 0 ? 0
+    : 100.0 * (1.0 - (double)runs.largest_run / ctx.available_blocks);
+  printf("%-12s %8.2f Mops/s %8zu failures %6.1f%% fragmentation %8.1f extents inspected/allocation\n",
+         name, bench_nb_ops / seconds / 1e6, failures, fragmentation,
+         allocations > 0 ? (double)ctx.nb_inspected / allocations : 0);
+  memory_ctx_destroy(&ctx);
+  free(addr);
+  free(size);
+}
 
-  int block_nb_needed = size/8 + 1; // add one block to store the size
-  if(size % 8 != 0) block_nb_needed++;
-  if(block_nb_needed*8 == m.blocks[addr-1]) {
-    m.error_no = E_SUCCESS;
-    return addr; // same size do nothing 
-  }else if(block_nb_needed*8 < m.blocks[addr-1]){ // new size < cur size
-    int nb_blocks_del = m.blocks[addr-1]/8 - block_nb_needed;
-    m.available_blocks+=m.blocks[addr-1]/8-block_nb_needed;
-    m.blocks[addr-1] = block_nb_needed*8;
-    for (int i=0; i < nb_blocks_del-1; i++) {
-      m.blocks[addr+block_nb_needed-1+i] = addr+block_nb_needed+i;
-    }
-    m.blocks[addr+block_nb_needed-2+nb_blocks_del] = m.first_block;
-    m.first_block = addr+block_nb_needed-1;
-    m.error_no = E_SUCCESS;
-    return addr;
-  }else { // new size > cur size
-    if(nb_consecutive_blocks(addr+(m.blocks[addr-1]/8)-1) < block_nb_needed-m.blocks[addr-1]/8) { // not enough space next to cur addr
-      memory_lifelike_free(addr);
-      return memory_lifelike_malloc((block_nb_needed-1)*8);
-    }else{ // enough space next to cur
-      // printf("// enough space next to cur\n");
-      int index = m.first_block;
-      // printf("addr+m.blocks[addr-1]/8-1 %ld\n", (addr+m.blocks[addr-1]/8-1));
-      while(m.blocks[index] != addr+m.blocks[addr-1]/8-1) index = m.blocks[index];
-      // printf("index: %d\n", index);
-      // printf("m.blocks[index] new value : %d\n", addr+block_nb_needed-1);
-      m.available_blocks-=block_nb_needed-m.blocks[addr-1]/8;
-      m.blocks[addr-1] = block_nb_needed*8;
-      m.blocks[index] = addr+block_nb_needed-1;
-      m.error_no = E_SUCCESS;
-      return addr;
+/* Link every other block of the heap, in the order they were freed
+ * (by increasing address), into a sorted list the way the free calls
+ * did before the list could be reordered at once: each block is
+ * inserted at its place by walking the list from its head. Return the
+ * head of the list.
+ */
+static int bench_sorted_inserts(struct memory_alloc_t *ctx) {
+  int head = NULL_BLOCK;
+  for(size_t i = 0; i < ctx->nb_blocks; i += 2) {
+    int prev = NULL_BLOCK;
+    int next = head;
+    while(next != NULL_BLOCK && next < (int)i) {
+      prev = next;
+      next = ctx->blocks[next];
+    }
+    ctx->blocks[i] = next;
+    if(prev == NULL_BLOCK) {
+      head = i;
+    }else{
+      ctx->blocks[prev] = i;
     }
   }
+  return head;
 }
 
-/* print the message corresponding to error_number */
-void memory_error_print(enum memory_errno error_number) {
-  switch(error_number) {
-  case E_SUCCESS:
-    printf("Success\n");
-    break;
-  case E_NOMEM:
-    printf("Not enough memory\n");
-    break;
-  case  E_SHOULD_PACK:
-    printf("Not enough contiguous blocks\n");
-    break;
-  default:
-    printf("Unknown\n");
-    break;
+/* Time memory_ctx_reorder() on heaps of growing sizes whose list links
+ * every other block, in decreasing order, against the sorted inserts of
+ * the same blocks, as a baseline (skipped on the largest heaps, where
+ * they are quadratic)
+ */
+static void bench_reorder() {
+  printf("Reorder of an unsorted list\n");
+  for(size_t nb_blocks = 1 << 12; nb_blocks <= 1 << 20; nb_blocks <<= 2) {
+    struct memory_alloc_t ctx;
+    memory_ctx_init(&ctx, nb_blocks);
+    double insert_seconds = -1;
+    if(nb_blocks <= 1 << 16) {
+      clock_t start = clock();
+      bench_sorted_inserts(&ctx);
+      insert_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+    ctx.first_block = NULL_BLOCK;
+    for(size_t i = 0; i < nb_blocks; i += 2) {
+      ctx.blocks[i] = ctx.first_block;
+      ctx.first_block = i;
+    }
+    ctx.available_blocks = (nb_blocks + 1) / 2;
+    memory_ctx_sync(&ctx);
+    clock_t start = clock();
+    memory_ctx_reorder(&ctx);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if(insert_seconds >= 0) {
+      printf("%8zu blocks %10.3f ms sorted inserts %10.3f ms reorder %8.2f ns/available block\n",
+             nb_blocks, insert_seconds * 1e3, seconds * 1e3, seconds * 1e9 / ctx.available_blocks);
+    }else{
+      printf("%8zu blocks %10s    sorted inserts %10.3f ms reorder %8.2f ns/available block\n",
+             nb_blocks, "-", seconds * 1e3, seconds * 1e9 / ctx.available_blocks);
+    }
+    memory_ctx_destroy(&ctx);
   }
 }
 
-/* Initialize an allocated buffer with zeros */
-void initialize_buffer(int start_index, size_t size) {
-  char* ptr = (char*)&m.blocks[start_index];
-  for(int i=0; i<size; i++) {
-    ptr[i]=0;
+/* Run the benchmarks on the trace file, or on the mixed workload if
+ * trace is NULL
+ */
+static void memory_bench(const char *trace) {
+  static const struct {
+    const char *name;
+    enum memory_placement placement;
+  } placements[] = {
+    { "first-fit", MEMORY_FIRST_FIT },
+    { "next-fit", MEMORY_NEXT_FIT },
+    { "best-fit", MEMORY_BEST_FIT },
+    { "worst-fit", MEMORY_WORST_FIT },
+    { "size-class", MEMORY_SIZE_CLASS },
+  };
+  if(trace == NULL) {
+    bench_mixed_trace();
+    printf("Mixed workload, %d blocks, %zu operations\n", BENCH_BLOCKS, bench_nb_ops);
+  }else if(bench_load_trace(trace) != 0) {
+    printf("Cannot read %s\n", trace);
+    return;
+  }else{
+    printf("Trace %s, %d blocks, %zu operations\n", trace, BENCH_BLOCKS, bench_nb_ops);
   }
+  for(size_t i = 0; i < sizeof(placements) / sizeof(placements[0]); i++) {
+    struct memory_options options = { .engine = MEMORY_LIST, .placement = placements[i].placement };
+    bench_run(placements[i].name, &options);
+  }
+  free(bench_ops);
+  bench_reorder();
 }
 
 /*************************************************/
@@ -273,23 +2546,32 @@ void initialize_buffer(int start_index, size_t size) {
 // m.blocks[A_B]
 #define A_B INT32_MIN
 
+/* Initialize m with a DEFAULT_SIZE blocks heap whose content is blocks */
+void init_m(memory_page_t blocks[DEFAULT_SIZE], size_t available_blocks, int first_block) {
+  memory_init(DEFAULT_SIZE);
+  for(int i = 0; i < DEFAULT_SIZE; i++) {
+    m.blocks[i] = blocks[i];
+  }
+  m.available_blocks = available_blocks;
+  m.first_block = first_block;
+  memory_sync();
+  m.error_no = INT32_MIN; // We initialize error_no with a value which we are sure that it cannot be set by the different memory_...() functions
+}
+
 /* Initialize m with all allocated blocks. So there is no available block */
 void init_m_with_all_allocated_blocks() {
-  struct memory_alloc_t m_init = {
+  memory_page_t blocks[DEFAULT_SIZE] = {
     // 0    1    2    3    4    5    6    7    8    9   10   11   12   13   14   15
-    {A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B},
-    0,
-    NULL_BLOCK,
-    INT32_MIN // We initialize error_no with a value which we are sure that it cannot be set by the different memory_...() functions
+    A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B, A_B
   };
-  m = m_init;
+  init_m(blocks, 0, NULL_BLOCK);
 }
 
 /* Test memory_init() */
 void test_exo1_memory_init(){
   init_m_with_all_allocated_blocks();
 
-  memory_init();
+  memory_init(DEFAULT_SIZE);
 
   // Check that m contains [0]->[1]->[2]->[3]->[4]->[5]->[6]->[7]->[8]->[9]->[10]->[11]->[12]->[13]->[14]->[15]->NULL_BLOCK
   assert_int_equal(0, m.first_block);
@@ -316,16 +2598,79 @@ void test_exo1_memory_init(){
   // We do not care about value of m.error_no
 }
 
+/* Test memory_init() with a heap of a million blocks */
+void test_exo1_memory_init_large_heap(){
+  size_t nb_blocks = 1 << 20;
+  memory_init(nb_blocks);
+  assert_int_equal(nb_blocks, m.nb_blocks);
+  assert_int_equal(nb_blocks, m.available_blocks);
+
+  // allocate the whole heap, then check that a full heap is handled
+  assert_int_equal(0, memory_allocate(nb_blocks*8));
+  assert_int_equal(NULL_BLOCK, m.first_block);
+  assert_int_equal(0, m.available_blocks);
+  assert_int_equal(NULL_BLOCK, memory_allocate(8));
+  assert_int_equal(E_NOMEM, m.error_no);
+
+  memory_free(0, nb_blocks*8);
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(NULL_BLOCK, m.blocks[nb_blocks-1]);
+  assert_int_equal(nb_blocks, m.available_blocks);
+
+  // blocks freed at both ends of the heap are linked in address order
+  assert_int_equal(0, memory_allocate(8));
+  assert_int_equal(1, memory_allocate((nb_blocks-2)*8));
+  assert_int_equal(nb_blocks-1, memory_allocate(8));
+  memory_free(0, 8);
+  memory_free(nb_blocks-1, 8);
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(nb_blocks-1, m.blocks[0]);
+  memory_destroy();
+}
+
+/* Test memory_init_region() with a region provided by the caller */
+void test_exo1_memory_init_region(){
+  memory_page_t region[4];
+  memory_init_region(region, 4);
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(1, region[0]);
+  assert_int_equal(NULL_BLOCK, region[3]);
+  assert_int_equal(4, m.available_blocks);
+  assert_int_equal(1, memory_lifelike_malloc(8));
+  assert_int_equal(16, region[0]);
+  memory_destroy();
+  assert_int_equal(0, m.nb_blocks);
+}
+
+/* Test that two heaps handled through their own context are independent */
+void test_exo1_memory_ctx_independent_heaps(){
+  struct memory_alloc_t a, b;
+  memory_ctx_init(&a, DEFAULT_SIZE);
+  memory_ctx_init(&b, 2*DEFAULT_SIZE);
+
+  assert_int_equal(0, memory_ctx_allocate(&a, 32));
+  assert_int_equal(1, memory_ctx_lifelike_malloc(&b, 8));
+  assert_int_equal(4, a.first_block);
+  assert_int_equal(DEFAULT_SIZE-4, a.available_blocks);
+  assert_int_equal(2, b.first_block);
+  assert_int_equal(2*DEFAULT_SIZE-2, b.available_blocks);
+
+  memory_ctx_lifelike_free(&b, 1);
+  assert_int_equal(2*DEFAULT_SIZE, b.available_blocks);
+  assert_int_equal(DEFAULT_SIZE-4, a.available_blocks);
+  assert_int_equal(E_SUCCESS, a.error_no);
+
+  memory_ctx_destroy(&a);
+  memory_ctx_destroy(&b);
+}
+
 /* Initialize m with some allocated blocks. The 10 available blocks are: [8]->[9]->[3]->[4]->[5]->[12]->[13]->[14]->[11]->[1]->NULL_BLOCK */
 void init_m_with_some_allocated_blocks() {
-  struct memory_alloc_t m_init = {
+  memory_page_t blocks[DEFAULT_SIZE] = {
     // 0           1    2    3    4    5    6    7    8    9   10   11   12   13   14   15
-    {A_B, NULL_BLOCK, A_B,   4,   5,  12, A_B, A_B,   9,   3, A_B,   1,  13,  14,  11, A_B},
-    10,
-    8,
-    INT32_MIN // We initialize error_no with a value which we are sure that it cannot be set by the different memory_...() functions
+    A_B, NULL_BLOCK, A_B,   4,   5,  12, A_B, A_B,   9,   3, A_B,   1,  13,  14,  11, A_B
   };
-  m = m_init;
+  init_m(blocks, 10, 8);
 }
 
 /* Test nb_consecutive_block() at the beginning of the available blocks list */
@@ -349,6 +2694,35 @@ void test_exo1_nb_consecutive_blocks_at_end_linked_list(){
   assert_int_equal(1, nb_consecutive_blocks(1));
 }
 
+/* Test nb_consecutive_blocks() and memory_allocate() on the extents of a sorted list */
+void test_exo1_nb_consecutive_blocks_extents(){
+  memory_init(DEFAULT_SIZE);
+  assert_int_equal(0, memory_allocate(16));
+  assert_int_equal(2, memory_allocate(24));
+  assert_int_equal(5, memory_allocate(8));
+  memory_free(2, 24);
+  // m contains the extents [2..4] and [6..15]
+  assert_int_equal(3, m.extent_len[2]);
+  assert_int_equal(10, m.extent_len[6]);
+  assert_int_equal(3, nb_consecutive_blocks(2));
+  assert_int_equal(2, nb_consecutive_blocks(3));
+  assert_int_equal(10, nb_consecutive_blocks(6));
+  assert_int_equal(6, nb_consecutive_blocks(10));
+
+  // the extent [2..4] is too small, [6..15] is used
+  assert_int_equal(6, memory_allocate(32));
+  assert_int_equal(6, m.extent_len[10]);
+  assert_int_equal(2, memory_allocate(24));
+  assert_int_equal(10, m.first_block);
+
+  // freeing [5] merges the extents on its left and on its right
+  memory_free(2, 24);
+  memory_free(6, 32);
+  memory_free(5, 8);
+  assert_int_equal(14, m.extent_len[2]);
+  assert_int_equal(2, m.first_block);
+}
+
 /* Test memory_allocate() when the blocks allocated are at the beginning of the linked list */
 void test_exo1_memory_allocate_beginning_linked_list(){
   init_m_with_some_allocated_blocks();
@@ -419,6 +2793,30 @@ void test_exo1_memory_allocate_too_many_blocks(){
   assert_int_equal(E_NOMEM, m.error_no);
 }
 
+/* Test that a request longer than every run is rejected without a search */
+void test_exo1_memory_allocate_longer_than_runs(){
+  memory_init(DEFAULT_SIZE);
+  int a = memory_allocate(8 * 4);
+  int b = memory_allocate(8 * 4);
+  int c = memory_allocate(8 * 4);
+  memory_free(a, 8 * 4);
+  memory_free(c, 8 * 4);
+  // [0..3] and [8..15] are available
+  assert_int_equal(12, m.available_blocks);
+  assert_int_equal(NULL_BLOCK, memory_allocate(8 * 10));
+  assert_int_equal(E_SHOULD_PACK, m.error_no);
+  assert_int_equal(9, m.largest_extent);
+  size_t nb_inspected = m.nb_inspected;
+  assert_int_equal(NULL_BLOCK, memory_allocate(8 * 9 + 1));
+  assert_int_equal(E_SHOULD_PACK, m.error_no);
+  assert_int_equal(nb_inspected, m.nb_inspected);
+
+  memory_free(b, 8 * 4);
+  assert_int_equal(DEFAULT_SIZE, m.largest_extent);
+  assert_int_equal(0, memory_allocate(8 * 10));
+  memory_destroy();
+}
+
 /* Test memory_free() */
 void test_exo1_memory_free(){
   init_m_with_some_allocated_blocks();
@@ -446,6 +2844,120 @@ void test_exo1_memory_free(){
   // We do not care about value of m.error_no
 }
 
+/* Test memory_allocate() and memory_free() with the buddy engine */
+void test_exo1_memory_buddy_split_merge(){
+  struct memory_options options = { .engine = MEMORY_BUDDY };
+  memory_init_with(NULL, 12, &options);
+  // the heap is made of [0..7] and [8..11]
+  assert_int_equal(8, memory_allocate(8 * 3)); // 3 blocks are rounded to 4
+  assert_int_equal(0, memory_allocate(8));      // [0..7] is split
+  assert_int_equal(1, memory_allocate(8));
+  assert_int_equal(E_SUCCESS, m.error_no);
+  assert_int_equal(6, m.available_blocks);
+  assert_int_equal(NULL_BLOCK, memory_allocate(8 * 8));
+  assert_int_equal(E_NOMEM, m.error_no);
+
+  memory_free(0, 8);
+  memory_free(8, 8 * 3);
+  memory_free(1, 8);
+  // the buddies are merged back
+  assert_int_equal(12, m.available_blocks);
+  assert_int_equal(8, m.extent_len[0]);
+  assert_int_equal(4, m.extent_len[8]);
+  assert_int_equal(0, memory_allocate(8 * 8));
+}
+
+/* Test memory_allocate() and memory_free() with the bitmap engine */
+void test_exo1_memory_bitmap_runs(){
+  struct memory_options options = { .engine = MEMORY_BITMAP };
+  memory_init_with(NULL, 200, &options);
+  assert_null(m.extent_len); // free_map is enough
+  assert_null(m.class_next);
+  assert_int_equal(0, memory_allocate(8 * 60));
+  assert_int_equal(60, memory_allocate(8 * 10));
+  assert_int_equal(70, memory_allocate(8 * 100)); // across several words
+  memory_free(0, 8 * 60);
+  // [0..59] and [170..199] are available
+  assert_int_equal(90, m.available_blocks);
+  assert_int_equal(NULL_BLOCK, memory_allocate(8 * 61));
+  assert_int_equal(E_SHOULD_PACK, m.error_no);
+  assert_int_equal(0, memory_allocate(8 * 40));
+  assert_int_equal(170, memory_allocate(8 * 25)); // [40..59] is too small
+  assert_int_equal(E_SUCCESS, m.error_no);
+  assert_int_equal(20, nb_consecutive_blocks(40));
+}
+
+/* Test memory_allocate() with the best-fit and worst-fit placements */
+void test_exo1_memory_allocate_best_fit(){
+  struct memory_options options = { .engine = MEMORY_LIST, .placement = MEMORY_BEST_FIT };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  memory_allocate(8 * 16);
+  memory_free(0, 8 * 5);
+  memory_free(6, 8 * 2);
+  memory_free(9, 8 * 3);
+  // [0..4], [6..7] and [9..11] are available
+  assert_int_equal(9, memory_allocate(8 * 3));
+  assert_int_equal(6, memory_allocate(8 * 1));
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(7, m.blocks[4]);
+  assert_int_equal(NULL_BLOCK, m.blocks[7]);
+
+  options.placement = MEMORY_WORST_FIT;
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  memory_allocate(8 * 16);
+  memory_free(0, 8 * 2);
+  memory_free(6, 8 * 5);
+  assert_int_equal(6, memory_allocate(8 * 1));
+  assert_int_equal(7, memory_allocate(8 * 1));
+  assert_int_equal(NULL_BLOCK, memory_allocate(8 * 4));
+  assert_int_equal(E_SHOULD_PACK, m.error_no);
+}
+
+/* Test memory_allocate() with the next-fit placement */
+void test_exo1_memory_allocate_next_fit(){
+  struct memory_options options = { .engine = MEMORY_LIST, .placement = MEMORY_NEXT_FIT };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  assert_int_equal(0, memory_allocate(8 * 4));
+  assert_int_equal(4, memory_allocate(8 * 4));
+  memory_free(0, 8 * 4);
+  assert_int_equal(8, memory_allocate(8 * 2)); // resumes after [4..7]
+  memory_free(8, 8 * 2);
+  // the cursor is now inside [8..15]: the search starts at its head
+  assert_int_equal(8, memory_allocate(8));
+  assert_int_equal(9, memory_allocate(8 * 4));
+  assert_int_equal(13, memory_allocate(8 * 3));
+  assert_int_equal(0, memory_allocate(8 * 4)); // wraps around
+  assert_int_equal(NULL_BLOCK, memory_allocate(8));
+  assert_int_equal(E_NOMEM, m.error_no);
+}
+
+/* a placement policy choosing the last extent of the list that fits */
+static int find_last_fit(struct memory_alloc_t *ctx, size_t block_nb) {
+  int last = NULL_BLOCK;
+  for(int index = ctx->first_block; index != NULL_BLOCK;
+      index = ctx->blocks[index + ctx->extent_len[index] - 1]) {
+    if(ctx->extent_len[index] >= block_nb) {
+      last = index;
+    }
+  }
+  return last;
+}
+
+/* Test memory_allocate() with a placement policy given at initialization */
+void test_exo1_memory_allocate_custom_policy(){
+  const struct memory_policy last_fit = { find_last_fit, find_last_fit, 0 };
+  struct memory_options options = { .engine = MEMORY_LIST, .policy = &last_fit };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  memory_allocate(8 * 16);
+  memory_free(0, 8 * 4);
+  memory_free(6, 8 * 4);
+  memory_free(12, 8 * 2);
+  assert_int_equal(6, memory_allocate(8 * 3));
+  assert_int_equal(12, memory_lifelike_malloc(8) - 1);
+  assert_int_equal(0, memory_allocate(8 * 4));
+  assert_int_equal(1, m.available_blocks);
+}
+
 /* Test memory_reorder() */
 void test_exo2_memory_reorder(){
   init_m_with_some_allocated_blocks();
@@ -469,6 +2981,28 @@ void test_exo2_memory_reorder(){
   // We do not care about value of m.error_no
 }
 
+/* Test that frees on an unsorted list reorder it once enough of them piled up */
+void test_exo2_memory_lazy_reorder(){
+  init_m_with_some_allocated_blocks();
+  memory_free(0, 8);
+  memory_free(2, 8);
+  memory_free(6, 8);
+  // 3 unsorted frees out of 13 available blocks: the list stays as is
+  assert_int_equal(0, m.sorted);
+  assert_int_equal(6, m.first_block);
+  assert_int_equal(2, m.blocks[6]);
+  memory_free(7, 8);
+  // 4 out of 14: [0]->[1]->...->[9]->[11]->...->[14]->NULL_BLOCK
+  assert_int_equal(1, m.sorted);
+  assert_int_equal(0, m.unsorted_frees);
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(1, m.blocks[0]);
+  assert_int_equal(11, m.blocks[9]);
+  assert_int_equal(NULL_BLOCK, m.blocks[14]);
+  assert_int_equal(10, m.extent_len[0]);
+  assert_int_equal(14, m.available_blocks);
+}
+
 /* Test memory_reorder() leading to successful memory_allocate() because we find enough consecutive bytes */
 void test_exo2_memory_reorder_leading_to_successful_memory_allocate(){
   init_m_with_some_allocated_blocks();
@@ -517,39 +3051,30 @@ void test_exo2_memory_reorder_leading_to_failed_memory_allocate(){
 
 /* Initialize m with some allocated blocks. The 10 available blocks are: [0]->[1]->[4]->[5]->[9]->[10]->[15]->NULL_BLOCK */
 void init_m_with_some_allocated_blocks_lifelike() {
-  struct memory_alloc_t m_init = {
+  memory_page_t blocks[DEFAULT_SIZE] = {
     // 0 1   2     3      4    5    6    7    8     9   10    11   12    13    14    15
-    {1,  4,  16,   A_B,   5,   6,   7,   8,   9,   10,  15,   32,  A_B,  A_B,  A_B,  NULL_BLOCK},
-    10,
-    0,
-    INT32_MIN // We initialize error_no with a value which we are sure that it cannot be set by the different memory_...() functions
+    1,  4,  16,   A_B,   5,   6,   7,   8,   9,   10,  15,   32,  A_B,  A_B,  A_B,  NULL_BLOCK
   };
-  m = m_init;
+  init_m(blocks, 10, 0);
 }
 
 /* Initialize m with some allocated blocks. The 10 available blocks are: [0]->[1]->[4]->[5]->[9]->[10]->[15]->NULL_BLOCK */
 void init_m_with_some_allocated_blocks_lifelike_free_old_area() {
-  struct memory_alloc_t m_init = {
+  memory_page_t blocks[DEFAULT_SIZE] = {
     // 0 1   2    3       4    5      6    7    8     9    10   11   12    13    14    15
-    {1,  6,  16,   A_B,   16,   A_B,   7,   8,   9,   10,  15,  32,  A_B,  A_B,  A_B,  NULL_BLOCK},
-    8,
-    0,
-    INT32_MIN // We initialize error_no with a value which we are sure that it cannot be set by the different memory_...() functions
+    1,  6,  16,   A_B,   16,   A_B,   7,   8,   9,   10,  15,  32,  A_B,  A_B,  A_B,  NULL_BLOCK
   };
-  m = m_init;
+  init_m(blocks, 8, 0);
 }
 
 
 /* Initialize m with some allocated blocks. The 10 available blocks are: [0]->[1]->[4]->[5]->[9]->[10]->[15]->NULL_BLOCK */
 void init_m_with_some_allocated_blocks_lifelike_not_enough_space() {
-  struct memory_alloc_t m_init = {
+  memory_page_t blocks[DEFAULT_SIZE] = {
     // 0 1    2      3      4     5    6    7     8     9     10    11    12   13           14  15
-    {5,  32,  A_B,   A_B,   A_B,  12,  48,  A_B,  A_B,  A_B,  A_B,  A_B,  13,  NULL_BLOCK,  8,  A_B},
-    4,
-    0,
-    INT32_MIN // We initialize error_no with a value which we are sure that it cannot be set by the different memory_...() functions
+    5,  32,  A_B,   A_B,   A_B,  12,  48,  A_B,  A_B,  A_B,  A_B,  A_B,  13,  NULL_BLOCK,  8,  A_B
   };
-  m = m_init;
+  init_m(blocks, 4, 0);
 }
 
 void test_exo3_memory_alloc_lifelike(){
@@ -574,12 +3099,14 @@ void test_exo3_memory_free_lifelike(){
   memory_lifelike_free(addr);
   // check that we have the good nb of available blocks after free
   assert_int_equal(block_available_after_malloc+block_needed+1, m.available_blocks);
-  assert_int_equal(m.first_block, 4);
+  // check that the blocks are back at their place: [0]->[1]->[4]->...->[8]->[9]->[10]->[15]
+  assert_int_equal(m.first_block, 0);
+  assert_int_equal(m.blocks[1], 4);
   assert_int_equal(m.blocks[4], 5);
   assert_int_equal(m.blocks[5], 6);
   assert_int_equal(m.blocks[6], 7);
   assert_int_equal(m.blocks[7], 8);
-  assert_int_equal(m.blocks[8], 0);
+  assert_int_equal(m.blocks[8], 9);
   assert_int_equal(E_SUCCESS, m.error_no);
 }
 
@@ -614,9 +3141,11 @@ void test_exo3_memory_realloc_lifelike_new_size_inf(){
   int prev_available_blocks = m.available_blocks;
   memory_lifelike_realloc(addr, 8);
   assert_int_equal(m.blocks[addr-1], 16);
-  assert_int_equal(m.first_block, 13);
+  // the released blocks are inserted between [10] and [15]
+  assert_int_equal(m.first_block, 0);
+  assert_int_equal(m.blocks[10], 13);
   assert_int_equal(m.blocks[13], 14);
-  assert_int_equal(m.blocks[14], 0);
+  assert_int_equal(m.blocks[14], 15);
   assert_int_equal(m.available_blocks-2, prev_available_blocks);
   assert_int_equal(E_SUCCESS, m.error_no);
 }
@@ -626,9 +3155,11 @@ void test_exo3_memory_realloc_lifelike_size_null(){
   int addr = 3;
   int prev_available_blocks = m.available_blocks;
   memory_lifelike_realloc(addr, 0); // behave like free
-  assert_int_equal(m.first_block, 2);
+  // the released blocks are inserted between [1] and [4]
+  assert_int_equal(m.first_block, 0);
+  assert_int_equal(m.blocks[1], 2);
   assert_int_equal(m.blocks[2], 3);
-  assert_int_equal(m.blocks[3], 0);
+  assert_int_equal(m.blocks[3], 4);
   assert_int_equal(m.available_blocks, prev_available_blocks+2);
 }
 
@@ -641,20 +3172,70 @@ void test_exo3_memory_realloc_lifelike_addr_null_block(){
   assert_int_equal(m.available_blocks, prev_available_blocks-5);
 }
 
+/* Test that freed blocks are inserted in address order */
+void test_exo3_memory_free_keeps_address_order(){
+  memory_init(DEFAULT_SIZE);
+  int a = memory_allocate(16);
+  int b = memory_lifelike_malloc(8);
+  int c = memory_allocate(16);
+  memory_free(a, 16);
+  memory_free(c, 16);
+  // m contains [0]->[1]->[4]->[5]->[6]->...->[15]->NULL_BLOCK
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(1, m.blocks[0]);
+  assert_int_equal(4, m.blocks[1]);
+  assert_int_equal(5, m.blocks[4]);
+  assert_int_equal(6, m.blocks[5]);
+  assert_int_equal(14, m.available_blocks);
+
+  memory_lifelike_free(b);
+  for(int i = 0; i < DEFAULT_SIZE-1; i++) {
+    assert_int_equal(i+1, m.blocks[i]);
+  }
+  assert_int_equal(NULL_BLOCK, m.blocks[DEFAULT_SIZE-1]);
+  assert_int_equal(0, memory_allocate(DEFAULT_SIZE*8));
+  assert_int_equal(E_SUCCESS, m.error_no);
+}
+
 void test_exo3_memory_realloc_lifelike_old_area_free(){
   init_m_with_some_allocated_blocks_lifelike_free_old_area();
   int addr = 3;
   int prev_available_blocks = m.available_blocks;
   int new_addr = memory_lifelike_realloc(addr, 3*8);
-  assert_int_equal(m.first_block, 2);
-  assert_int_equal(m.blocks[2], 3);
-  assert_int_equal(m.blocks[3], 0);
-  assert_int_equal(new_addr, 7); // check address returned is good
-  assert_int_equal(m.blocks[6], 4*8); 
-  assert_int_equal(m.blocks[1], 10); 
+  // the old area [2]->[3] joins [0]->[1] so that [0..3] is the first fit
+  assert_int_equal(new_addr, 1); // check address returned is good
+  assert_int_equal(m.blocks[0], 4*8);
+  assert_int_equal(m.first_block, 6);
+  assert_int_equal(m.blocks[6], 7);
   assert_int_equal(m.available_blocks, prev_available_blocks-2);
 }
 
+/* Test that realloc merges the area with the free extent on its left and keeps its content */
+void test_exo3_memory_realloc_lifelike_coalesce_left(){
+  memory_init(DEFAULT_SIZE);
+  int a = memory_lifelike_malloc(8);
+  int b = memory_lifelike_malloc(8);
+  int c = memory_lifelike_malloc(8);
+  m.blocks[b] = 42;
+  m.blocks[c] = 43;
+  memory_lifelike_free(a);
+
+  int new_b = memory_lifelike_realloc(b, 24);
+  assert_int_equal(1, new_b);
+  assert_int_equal(32, m.blocks[0]);
+  assert_int_equal(42, m.blocks[new_b]);
+  assert_int_equal(6, m.first_block);
+  assert_int_equal(10, m.extent_len[6]);
+  assert_int_equal(10, m.available_blocks);
+  assert_int_equal(E_SUCCESS, m.error_no);
+
+  // c cannot grow: it is left untouched
+  assert_int_equal(NULL_BLOCK, memory_lifelike_realloc(c, 200));
+  assert_int_equal(16, m.blocks[c-1]);
+  assert_int_equal(43, m.blocks[c]);
+  assert_int_equal(10, m.available_blocks);
+}
+
 void test_exo3_memory_realloc_lifelike_not_enough_memory(){
   init_m_with_some_allocated_blocks_lifelike_not_enough_space();
   int addr = 2;
@@ -664,7 +3245,669 @@ void test_exo3_memory_realloc_lifelike_not_enough_memory(){
 }
 
 
+void test_exo3_memory_lifelike_malloc_size_class(){
+  memory_init(DEFAULT_SIZE);
+  int big = memory_lifelike_malloc(8 * 5);
+  memory_lifelike_malloc(8 * 1);
+  int small = memory_lifelike_malloc(8 * 2);
+  memory_lifelike_malloc(8 * 1);
+  memory_lifelike_free(big);
+  memory_lifelike_free(small);
+  /* blocks [0,6) and [8,11) are free extents, the 3-block one is reused
+   * although the 6-block extent comes first
+   */
+  int addr = memory_lifelike_malloc(8 * 2);
+  assert_int_equal(addr, small);
+  assert_int_equal(m.error_no, E_SUCCESS);
+}
+
+
+void test_exo3_memory_buddy_lifelike(){
+  struct memory_options options = { .engine = MEMORY_BUDDY };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  int addr = memory_lifelike_malloc(8 * 2);
+  assert_int_equal(1, addr);
+  assert_int_equal(4 * 8, m.blocks[0]); // 3 blocks are rounded to 4
+  m.blocks[addr] = 42;
+  m.blocks[addr+1] = 43;
+
+  // [4..7] is too small for 6 blocks, rounded to 8
+  int new_addr = memory_lifelike_realloc(addr, 8 * 5);
+  assert_int_equal(9, new_addr);
+  assert_int_equal(8 * 8, m.blocks[8]);
+  assert_int_equal(42, m.blocks[new_addr]);
+  assert_int_equal(43, m.blocks[new_addr+1]);
+  assert_int_equal(8, m.available_blocks);
+
+  // shrinking gives back the upper halves
+  new_addr = memory_lifelike_realloc(new_addr, 8);
+  assert_int_equal(9, new_addr);
+  assert_int_equal(2 * 8, m.blocks[8]);
+  assert_int_equal(14, m.available_blocks);
+
+  memory_lifelike_free(new_addr);
+  assert_int_equal(DEFAULT_SIZE, m.available_blocks);
+  assert_int_equal(DEFAULT_SIZE, m.extent_len[0]);
+}
+
+
+void test_exo3_memory_bitmap_lifelike(){
+  struct memory_options options = { .engine = MEMORY_BITMAP };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  int addr = memory_lifelike_malloc(8 * 2);
+  assert_int_equal(1, addr);
+  m.blocks[addr] = 42;
+  // the blocks after the area are available: it grows in place
+  assert_int_equal(addr, memory_lifelike_realloc(addr, 8 * 5));
+  assert_int_equal(6 * 8, m.blocks[0]);
+  assert_int_equal(42, m.blocks[addr]);
+  assert_int_equal(10, m.available_blocks);
+
+  int other = memory_lifelike_malloc(8);
+  assert_int_equal(7, other);
+  // no room after the area anymore: it moves
+  int new_addr = memory_lifelike_realloc(addr, 8 * 6);
+  assert_int_equal(9, new_addr);
+  assert_int_equal(42, m.blocks[new_addr]);
+  assert_int_equal(7, m.available_blocks);
+
+  memory_lifelike_free(new_addr);
+  memory_lifelike_free(other);
+  assert_int_equal(DEFAULT_SIZE, m.available_blocks);
+}
+
+
+void test_exo3_memory_tlsf_lifelike(){
+  struct memory_options options = { .engine = MEMORY_TLSF };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  int a1 = memory_lifelike_malloc(8 * 3);
+  int a2 = memory_lifelike_malloc(8 * 2);
+  int a3 = memory_lifelike_malloc(8 * 3);
+  assert_int_equal(1, a1);
+  assert_int_equal(5, a2);
+  assert_int_equal(8, a3);
+  assert_int_equal(4 * 8, m.blocks[a1-1]);
+  assert_int_equal(5, m.available_blocks);
+
+  // [0..3] and [7..10] are merged with [4..6] at once
+  memory_lifelike_free(a1);
+  memory_lifelike_free(a3);
+  memory_lifelike_free(a2);
+  assert_int_equal(DEFAULT_SIZE, m.available_blocks);
+  assert_int_equal(DEFAULT_SIZE, m.extent_len[0]);
+
+  a1 = memory_lifelike_malloc(8 * 2);
+  m.blocks[a1] = 42;
+  assert_int_equal(a1, memory_lifelike_realloc(a1, 8 * 9)); // grows in place
+  assert_int_equal(42, m.blocks[a1]);
+  assert_int_equal(6, m.available_blocks);
+  assert_int_equal(NULL_BLOCK, memory_lifelike_realloc(a1, 8 * 20));
+  assert_int_equal(E_NOMEM, m.error_no);
+  assert_int_equal(10 * 8, m.blocks[a1-1]);
+  memory_destroy();
+
+  // 17 blocks are rounded to the range [18..19], but [16..17] holds the extent
+  memory_init_with(NULL, 32, &options);
+  a1 = memory_lifelike_malloc(8 * 16);
+  a2 = memory_lifelike_malloc(8 * 14);
+  memory_lifelike_free(a1);
+  assert_int_equal(17, m.available_blocks);
+  assert_int_equal(1, memory_lifelike_malloc(8 * 16));
+  assert_int_equal(E_SUCCESS, m.error_no);
+  assert_int_equal(0, m.available_blocks);
+  memory_destroy();
+}
+
+/* The lifelike calls above, run against each engine but the buddy one */
+void test_exo3_memory_lifelike_engines(){
+  static const enum memory_engine engines[] = { MEMORY_LIST, MEMORY_BITMAP, MEMORY_TLSF };
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+    struct memory_options options = { .engine = engines[e] };
+    memory_init_with(NULL, DEFAULT_SIZE, &options);
+    int a = memory_lifelike_malloc(8);
+    int b = memory_lifelike_malloc(8);
+    int c = memory_lifelike_malloc(8);
+    assert_int_equal(1, a);
+    assert_int_equal(3, b);
+    assert_int_equal(5, c);
+    assert_int_equal(16, m.blocks[b-1]);
+    assert_int_equal(10, m.available_blocks);
+    m.blocks[b] = 42;
+    m.blocks[c] = 43;
+
+    assert_int_equal(b, memory_lifelike_realloc(b, 8)); // same size
+    assert_int_equal(10, m.available_blocks);
+
+    memory_lifelike_free(a);
+    assert_int_equal(12, m.available_blocks);
+    b = memory_lifelike_realloc(b, 24); // c is in the way: b moves
+    assert_int_equal(32, m.blocks[b-1]);
+    assert_int_equal(42, m.blocks[b]);
+    assert_int_equal(10, m.available_blocks);
+
+    assert_int_equal(b, memory_lifelike_realloc(b, 8)); // shrinks in place
+    assert_int_equal(16, m.blocks[b-1]);
+    assert_int_equal(42, m.blocks[b]);
+    assert_int_equal(12, m.available_blocks);
+
+    memory_lifelike_realloc(b, 0); // behaves like free
+    assert_int_equal(14, m.available_blocks);
+    b = memory_lifelike_realloc(NULL_BLOCK, 8); // behaves like malloc
+    assert_int_not_equal(NULL_BLOCK, b);
+    assert_int_equal(12, m.available_blocks);
+
+    assert_int_equal(NULL_BLOCK, memory_lifelike_realloc(c, 200)); // left untouched
+    assert_int_equal(E_NOMEM, m.error_no);
+    assert_int_equal(16, m.blocks[c-1]);
+    assert_int_equal(43, m.blocks[c]);
+
+    memory_lifelike_free(b);
+    memory_lifelike_free(c);
+    assert_int_equal(DEFAULT_SIZE, m.available_blocks);
+    memory_destroy();
+  }
+}
+
+void test_exo3_memory_pack(){
+  memory_init(DEFAULT_SIZE);
+  int a1 = memory_lifelike_malloc(8 * 2);
+  int a2 = memory_lifelike_malloc(8 * 2);
+  int a3 = memory_lifelike_malloc(8 * 2);
+  int p = memory_allocate(8);
+  int a4 = memory_lifelike_malloc(8 * 1);
+  assert_int_equal(9, p);
+  assert_int_equal(11, a4);
+  m.blocks[a3] = 42;
+  memory_lifelike_free(a2);
+
+  struct memory_relocation *relocations;
+  size_t nb_relocations;
+  memory_pack(&relocations, &nb_relocations);
+  assert_int_equal(E_SUCCESS, m.error_no);
+  assert_int_equal(1, nb_relocations);
+  assert_int_equal(a3, relocations[0].old_addr);
+  assert_int_equal(4, relocations[0].new_addr);
+  assert_int_equal(1, memory_relocated(relocations, nb_relocations, a1));
+  assert_int_equal(4, memory_relocated(relocations, nb_relocations, a3));
+  assert_int_equal(11, memory_relocated(relocations, nb_relocations, a4));
+  free(relocations);
+  a3 = 4;
+  assert_int_equal(42, m.blocks[a3]);
+  assert_int_equal(3 * 8, m.blocks[a3-1]);
+
+  // the block of memory_allocate() stays pinned between [6..8] and [12..15]
+  assert_int_equal(7, m.available_blocks);
+  assert_int_equal(3, m.extent_len[6]);
+  assert_int_equal(4, m.extent_len[12]);
+  memory_free(p, 8);
+  memory_pack(&relocations, &nb_relocations);
+  assert_int_equal(1, nb_relocations);
+  assert_int_equal(7, relocations[0].new_addr);
+  free(relocations);
+  assert_int_equal(8, m.extent_len[8]);
+  assert_int_equal(9, memory_lifelike_malloc(8 * 7));
+  memory_lifelike_free(1);
+  memory_lifelike_free(4);
+  memory_lifelike_free(7);
+  memory_lifelike_free(9);
+  assert_int_equal(DEFAULT_SIZE, m.available_blocks);
+}
+
+void test_exo3_memory_handles(){
+  memory_init(DEFAULT_SIZE);
+  int h1 = memory_handle_malloc(8 * 2);
+  int h2 = memory_handle_malloc(8 * 2);
+  int h3 = memory_handle_malloc(8 * 2);
+  assert_int_equal(0, h1);
+  assert_int_equal(1, h2);
+  assert_int_equal(2, h3);
+  assert_int_equal(7, memory_resolve(h3));
+  m.blocks[memory_resolve(h3)] = 42;
+
+  memory_handle_free(h2);
+  memory_pack(NULL, NULL);
+  assert_int_equal(1, memory_resolve(h1));
+  assert_int_equal(4, memory_resolve(h3)); // moved without the caller noticing
+  assert_int_equal(42, m.blocks[memory_resolve(h3)]);
+
+  assert_int_equal(h3, memory_handle_realloc(h3, 8 * 5));
+  assert_int_equal(42, m.blocks[memory_resolve(h3)]);
+  assert_int_equal(h2, memory_handle_malloc(8 * 6)); // the handle is reused
+  assert_int_equal(10, memory_resolve(h2));
+  assert_int_equal(NULL_BLOCK, memory_handle_realloc(h1, 0));
+  memory_handle_free(h2);
+  memory_handle_free(h3);
+  assert_int_equal(DEFAULT_SIZE, m.available_blocks);
+  memory_destroy();
+}
+
+void test_exo3_memory_handles_chunks(){
+  memory_init(1 << 10);
+  int h0 = memory_handle_malloc(8);
+  const int *chunk = m.handles[0];
+  for(int h = 1; h < MEMORY_HANDLE_CHUNK + 1; h++) {
+    assert_int_equal(h, memory_handle_malloc(8));
+  }
+  assert_int_equal(2 * MEMORY_HANDLE_CHUNK, m.handles_capacity);
+  assert_ptr_equal(chunk, m.handles[0]); // a resolve in flight still reads the table
+  assert_int_equal(1, memory_resolve(h0));
+  assert_int_equal(2 * MEMORY_HANDLE_CHUNK + 1, memory_resolve(MEMORY_HANDLE_CHUNK));
+  memory_destroy();
+}
+
+void test_exo3_memory_defrag_step(){
+  static const enum memory_engine engines[] = { MEMORY_LIST, MEMORY_BITMAP, MEMORY_TLSF };
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+    struct memory_options options = { .engine = engines[e] };
+    memory_init_with(NULL, DEFAULT_SIZE, &options);
+    int a1 = memory_lifelike_malloc(8 * 2);
+    int a2 = memory_lifelike_malloc(8 * 2);
+    int a3 = memory_lifelike_malloc(8 * 2);
+    int h4 = memory_handle_malloc(8 * 2);
+    assert_int_equal(10, memory_resolve(h4));
+    m.blocks[a2] = 42;
+    memory_lifelike_free(a1);
+    memory_lifelike_free(a3);
+
+    struct memory_relocation *relocations;
+    size_t nb_relocations;
+    struct memory_defrag_stats stats;
+    struct memory_fragmentation fragmentation;
+    memory_defrag_step(3, &relocations, &nb_relocations, &stats);
+    assert_int_equal(1, nb_relocations);
+    assert_int_equal(1, memory_relocated(relocations, nb_relocations, a2));
+    free(relocations);
+    assert_int_equal(42, m.blocks[1]);
+    assert_int_equal(3, stats.moved_blocks);
+    assert_int_equal(0, stats.done);
+    memory_fragmentation(&fragmentation);
+    assert_int_equal(6, fragmentation.largest_run); // [3..8]
+    assert_int_equal(2, fragmentation.nb_extents);
+
+    memory_defrag_step(3, NULL, NULL, &stats);
+    assert_int_equal(4, memory_resolve(h4));
+    memory_fragmentation(&fragmentation);
+    assert_int_equal(10, fragmentation.largest_run);
+    assert_int_equal(1, fragmentation.nb_extents);
+    memory_defrag_step(3, NULL, NULL, &stats);
+    assert_int_equal(0, stats.moved_blocks);
+    assert_int_equal(1, stats.done);
+    assert_int_equal(10, m.available_blocks);
+    assert_int_equal(6 + 1, memory_lifelike_malloc(8 * 9));
+    memory_destroy();
+  }
+}
+
+void test_exo3_memory_defrag_step_bitmap_run(){
+  struct memory_options options = { .engine = MEMORY_BITMAP };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  int a1 = memory_lifelike_malloc(8 * 2);
+  int a2 = memory_lifelike_malloc(8 * 2);
+  int a3 = memory_lifelike_malloc(8 * 2);
+  int a4 = memory_lifelike_malloc(8 * 2);
+  m.blocks[a4] = 42;
+  memory_lifelike_free(a2);
+  struct memory_relocation *relocations;
+  size_t nb_relocations;
+  memory_defrag_step(3, &relocations, &nb_relocations, NULL); // the step stops at 6
+  a3 = memory_relocated(relocations, nb_relocations, a3);
+  free(relocations);
+  assert_int_equal(a2, a3);
+  memory_lifelike_free(a1);
+  memory_lifelike_free(a3);
+  // the run [0..8] starts before where the step resumes
+  memory_defrag_step(3, &relocations, &nb_relocations, NULL);
+  assert_int_equal(1, memory_relocated(relocations, nb_relocations, a4));
+  free(relocations);
+  assert_int_equal(42, m.blocks[1]);
+  assert_int_equal(3, bitmap_next(&m.free_map, 0)); // no hole in front of a4
+  assert_int_equal(DEFAULT_SIZE, bitmap_next_clear(&m.free_map, 3));
+  memory_destroy();
+}
+
+void test_exo3_memory_defrag_step_budget(){
+  memory_init(DEFAULT_SIZE);
+  for(int i = 0; i < 10; i++) {
+    assert_int_equal(i, memory_allocate(8));
+  }
+  for(int i = 0; i < 10; i += 2) {
+    memory_free(i, 8);
+  }
+  struct memory_defrag_stats stats;
+  memory_defrag_step(2, NULL, NULL, &stats); // skips the blocks 1 and 3
+  assert_int_equal(0, stats.moved_blocks);
+  assert_int_equal(0, stats.done);
+  assert_int_equal(4, m.defrag_pos);
+  memory_defrag_step(8, NULL, NULL, &stats);
+  assert_int_equal(1, stats.done);
+  memory_destroy();
+}
+
+void test_exo1_memory_pool(){
+  memory_init(DEFAULT_SIZE);
+  assert_int_equal(0, memory_allocate(8 * 2));
+  struct memory_pool pool;
+  memory_pool_init(&pool, 12, 4); // slots of 2 blocks in [2..9]
+  assert_int_equal(2, pool.first);
+  assert_int_equal(6, m.available_blocks);
+  assert_int_equal(2, memory_pool_alloc(&pool));
+  assert_int_equal(4, memory_pool_alloc(&pool));
+  assert_int_equal(6, memory_pool_alloc(&pool));
+  assert_int_equal(8, memory_pool_alloc(&pool));
+  assert_int_equal(NULL_BLOCK, memory_pool_alloc(&pool));
+  assert_int_equal(4, pool.head >> 32); // every pop bumps the tag
+
+  memory_pool_free(&pool, 4);
+  memory_pool_free(&pool, 8);
+  assert_int_equal(8, memory_pool_alloc(&pool)); // last in, first out
+  assert_int_equal(4, memory_pool_alloc(&pool));
+  assert_int_equal(8, pool.head >> 32);
+  memory_pool_free(&pool, 2);
+  memory_pool_free(&pool, 4);
+  memory_pool_free(&pool, 6);
+  memory_pool_free(&pool, 8);
+  memory_pool_destroy(&pool);
+  assert_int_equal(14, m.available_blocks);
+  memory_destroy();
+}
+
+void test_exo1_memory_arenas(){
+  struct memory_arenas arenas;
+  memory_arenas_init(&arenas, 4, 4 * DEFAULT_SIZE + 2, NULL);
+  assert_int_equal(4, arenas.nb_arenas);
+  assert_int_equal(DEFAULT_SIZE, arenas.arena_blocks);
+  assert_int_equal(DEFAULT_SIZE + 2, arenas.arenas[3].nb_blocks);
+  for(size_t k = 0; k < 4; k++) { // no two arenas share a cache line
+    assert_int_equal(0, (uintptr_t)&arenas.arenas[k] % MEMORY_CACHE_LINE);
+  }
+
+  int a = memory_arenas_allocate(&arenas, 8 * 12);
+  size_t home = a / DEFAULT_SIZE;
+  assert_int_equal(home * DEFAULT_SIZE, a);
+  int b = memory_arenas_lifelike_malloc(&arenas, 8 * 3);
+  assert_int_equal(a + 12 + 1, b);
+  arenas.blocks[b] = 42;
+  // the home arena is full: the next one is used
+  size_t next = (home + 1) % 4;
+  int c = memory_arenas_allocate(&arenas, 8);
+  assert_int_equal(next * DEFAULT_SIZE, c);
+  assert_int_equal(DEFAULT_SIZE - 1, arenas.arenas[next].available_blocks);
+
+  // the frees go back to the arena owning the blocks
+  memory_arenas_free(&arenas, c, 8);
+  assert_int_equal(DEFAULT_SIZE, arenas.arenas[next].available_blocks);
+  memory_arenas_lifelike_free(&arenas, b);
+  memory_arenas_free(&arenas, a, 8 * 12);
+  assert_int_equal(DEFAULT_SIZE, arenas.arenas[home].available_blocks);
+  memory_arenas_destroy(&arenas);
+}
+
+void test_exo1_memory_arenas_failed_init(){
+  struct memory_arenas arenas;
+  memory_arenas_init(&arenas, 4, 3, NULL); // less than a block per arena
+  assert_int_equal(0, arenas.nb_arenas);
+  assert_int_equal(NULL_BLOCK, memory_arenas_allocate(&arenas, 8));
+  assert_int_equal(NULL_BLOCK, memory_arenas_lifelike_malloc(&arenas, 8));
+  memory_arenas_free(&arenas, 0, 8);
+  memory_arenas_lifelike_free(&arenas, 1);
+  memory_arenas_destroy(&arenas);
+
+  memory_arenas_init(&arenas, 0, DEFAULT_SIZE, NULL);
+  assert_int_equal(0, arenas.nb_arenas);
+  assert_int_equal(NULL_BLOCK, memory_arenas_allocate(&arenas, 8));
+  memory_arenas_destroy(&arenas);
+}
+
+void test_exo3_memory_remote_free(){
+  memory_init(DEFAULT_SIZE);
+  int a1 = memory_lifelike_malloc(8 * 2);
+  int a2 = memory_lifelike_malloc(8 * 2);
+  int a3 = memory_lifelike_malloc(8 * 2);
+  memory_ctx_remote_free(&m, a1);
+  memory_ctx_remote_free(&m, a3);
+  // nothing is freed yet: a3 links to a1 in its header
+  assert_int_equal(7, m.available_blocks);
+  assert_int_equal(a3, m.remote_frees);
+  assert_int_equal(a1, m.blocks[a3-1] >> 32);
+  assert_int_equal(3 * 8, m.blocks[a3-1] & 0xffffffff);
+
+  // the next allocation frees them first
+  assert_int_equal(a1, memory_lifelike_malloc(8 * 2));
+  assert_int_equal(NULL_BLOCK, m.remote_frees);
+  assert_int_equal(10, m.available_blocks);
+  // pack frees a2 before sliding the areas down
+  memory_ctx_remote_free(&m, a2);
+  memory_pack(NULL, NULL);
+  assert_int_equal(13, m.available_blocks);
+  assert_int_equal(a2, memory_lifelike_malloc(8 * 2));
+  memory_destroy();
+
+  // an area spilled to another arena is freed remotely
+  struct memory_arenas arenas;
+  memory_arenas_init(&arenas, 2, 2 * DEFAULT_SIZE, NULL);
+  int a = memory_arenas_allocate(&arenas, 8 * DEFAULT_SIZE);
+  size_t next = 1 - a / DEFAULT_SIZE;
+  int b = memory_arenas_lifelike_malloc(&arenas, 8 * 3);
+  assert_int_equal(next * DEFAULT_SIZE + 1, b);
+  memory_arenas_lifelike_free(&arenas, b);
+  assert_int_equal(DEFAULT_SIZE - 4, arenas.arenas[next].available_blocks);
+  assert_int_equal(1, arenas.arenas[next].remote_frees);
+  // its owner frees it on its next allocation
+  assert_int_equal(0, memory_ctx_allocate(&arenas.arenas[next], 8 * DEFAULT_SIZE));
+  assert_int_equal(NULL_BLOCK, arenas.arenas[next].remote_frees);
+  memory_arenas_destroy(&arenas);
+}
+
+void test_exo1_memory_lifelike_malloc_batch(){
+  memory_init(DEFAULT_SIZE);
+  int out[6];
+  assert_int_equal(5, memory_lifelike_malloc_batch(8 * 2, 6, out));
+  assert_int_equal(E_NOMEM, m.error_no);
+  for(int i = 0; i < 5; i++) {
+    assert_int_equal(3 * i + 1, out[i]);
+    assert_int_equal(3 * 8, m.blocks[out[i]-1]);
+  }
+  assert_int_equal(1, m.available_blocks);
+
+  memory_lifelike_free(out[1]);
+  memory_lifelike_free(out[3]);
+  int a = out[0];
+  assert_int_equal(0, memory_lifelike_malloc_batch(8 * 4, 1, out));
+  assert_int_equal(E_SHOULD_PACK, m.error_no);
+  assert_int_equal(2, memory_lifelike_malloc_batch(8 * 2, 2, out));
+  assert_int_equal(E_SUCCESS, m.error_no);
+  assert_int_equal(4, out[0]);
+  assert_int_equal(10, out[1]);
+  memory_lifelike_free(a);
+  memory_destroy();
+}
+
+void test_exo2_memory_lifelike_free_bulk(){
+  memory_init(DEFAULT_SIZE);
+  int out[5];
+  assert_int_equal(5, memory_lifelike_malloc_batch(8 * 2, 5, out));
+  // freed one by one, the list would be left unsorted
+  m.sorted = 0;
+  int addrs[] = {out[3], out[0], out[4], out[1]};
+  memory_lifelike_free_bulk(addrs, 4);
+  assert_int_equal(1, addrs[0]);
+  assert_int_equal(13, addrs[3]);
+  assert_int_equal(13, m.available_blocks);
+  assert_int_equal(1, m.sorted);
+  assert_int_equal(0, m.first_block);
+  assert_int_equal(9, m.blocks[5]); // the run of areas 0 and 1 links past area 2
+  assert_int_equal(6, m.extent_len[0]);
+  assert_int_equal(7, m.extent_len[9]);
+  memory_destroy();
+}
+
+void test_exo1_memory_allocate_nozero(){
+  struct memory_alloc_t b;
+  struct memory_options options = { .engine = MEMORY_BITMAP };
+  memory_ctx_init_with(&b, NULL, DEFAULT_SIZE, &options);
+  assert_int_equal(DEFAULT_SIZE, bitmap_count(&b.zero_map));
+  int a = memory_ctx_allocate_nozero(&b, 8 * 4);
+  assert_int_equal(0, a);
+  b.blocks[1] = 42;
+  memory_ctx_free(&b, a, 8 * 4);
+  // the blocks given back may have been written
+  assert_int_equal(DEFAULT_SIZE - 4, bitmap_count(&b.zero_map));
+  assert_int_equal(0, memory_ctx_allocate_nozero(&b, 8 * 4));
+  assert_int_equal(42, b.blocks[1]);
+  memory_ctx_free(&b, a, 8 * 4);
+
+  assert_int_equal(1, memory_ctx_lifelike_calloc(&b, 2, 8 * 3));
+  for(int i = 1; i <= 6; i++) {
+    assert_int_equal(0, b.blocks[i]);
+  }
+  assert_int_equal(NULL_BLOCK, memory_ctx_lifelike_calloc(&b, SIZE_MAX / 2, 8 * 3));
+  assert_int_equal(E_NOMEM, b.error_no);
+  memory_ctx_destroy(&b);
+}
+
+void test_exo3_memory_buddy_shrink_not_zero(){
+  struct memory_options options = { .engine = MEMORY_BUDDY };
+  memory_init_with(NULL, DEFAULT_SIZE, &options);
+  int a = memory_lifelike_malloc(8 * 15);
+  for(int i = 0; i < 15; i++) {
+    m.blocks[a + i] = 42;
+  }
+  assert_int_equal(a, memory_lifelike_realloc(a, 8));
+  // the upper halves given back were written
+  assert_int_equal(NULL_BLOCK, bitmap_next(&m.zero_map, 2));
+  int b = memory_lifelike_malloc(8 * 7);
+  assert_int_equal(8 + 1, b);
+  for(int i = 0; i < 7; i++) {
+    assert_int_equal(0, m.blocks[b + i]);
+  }
+  memory_destroy();
+}
+
+#ifdef MEMORY_THREAD_SAFE
+/* malloc/free pairs of small lifelike areas, served by the thread cache */
+static void *memory_cache_worker(void *arg) {
+  long id = (long)arg;
+  for(int i = 0; i < 10000; i++) {
+    int addr = memory_lifelike_malloc(8 * (1 + i % 8));
+    assert_int_not_equal(NULL_BLOCK, addr);
+    m.blocks[addr] = id;
+    assert_int_equal(id, m.blocks[addr]);
+    memory_lifelike_free(addr);
+  }
+  memory_cache_flush();
+  return NULL;
+}
+
+void test_exo3_memory_thread_cache(){
+  memory_init(1 << 12);
+  pthread_t threads[4];
+  for(long i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, memory_cache_worker, (void *)i);
+  }
+  for(int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  assert_int_equal(1 << 12, m.available_blocks);
+  memory_destroy();
+}
+
+void test_exo3_memory_cached_areas(){
+  memory_init(1 << 10); // the cache takes 16 areas at once
+  int a = memory_lifelike_malloc(8);
+  assert_int_equal(2 * 8 | MEMORY_CACHED, m.blocks[a-1]);
+  size_t available = m.available_blocks;
+  m.blocks[a] = 42;
+  // a same-size realloc keeps the area, cached and untouched
+  assert_int_equal(a, memory_lifelike_realloc(a, 8));
+  assert_int_equal(2 * 8 | MEMORY_CACHED, m.blocks[a-1]);
+  assert_int_equal(42, m.blocks[a]);
+  assert_int_equal(available, m.available_blocks);
+  // shrinking gives the blocks back to the heap, not to the cache
+  int b = memory_lifelike_malloc(8 * 3);
+  available = m.available_blocks;
+  assert_int_equal(b, memory_lifelike_realloc(b, 8));
+  assert_int_equal(2 * 8, m.blocks[b-1]);
+  assert_int_equal(available + 2, m.available_blocks);
+  // growing keeps the content
+  a = memory_lifelike_realloc(a, 8 * 20);
+  assert_int_equal(42, m.blocks[a]);
+
+  // cached areas are pinned by pack
+  int h = memory_handle_malloc(8);
+  m.blocks[memory_resolve(h)] = 7;
+  int c = memory_lifelike_malloc(8);
+  m.blocks[c] = 43;
+  memory_pack(NULL, NULL);
+  assert_int_equal(43, m.blocks[c]);
+  assert_int_equal(7, m.blocks[memory_resolve(h)]);
+  memory_handle_free(h);
+
+  // cached areas freed in bulk or remotely go back to the heap
+  int d = memory_lifelike_malloc(8);
+  int addrs[] = {c, b};
+  memory_lifelike_free_bulk(addrs, 2);
+  memory_ctx_remote_free(&m, d);
+  memory_lifelike_free(a);
+  memory_cache_flush();
+  memory_pack(NULL, NULL);
+  assert_int_equal(1 << 10, m.available_blocks);
+  memory_destroy();
+}
+
+void test_exo3_memory_cache_two_heaps(){
+  struct memory_alloc_t b;
+  struct memory_alloc_t c;
+  memory_ctx_init(&b, 4 * DEFAULT_SIZE);
+  memory_ctx_init(&c, 4 * DEFAULT_SIZE);
+  int a = memory_ctx_lifelike_malloc(&b, 8);
+  assert_ptr_equal(&b, cache.ctx);
+  // with the lock of c held, the cache working on b is left alone
+  int h = memory_ctx_handle_malloc(&c, 8);
+  assert_ptr_equal(&b, cache.ctx);
+  int addr = memory_ctx_resolve(&c, h);
+  assert_int_equal(2 * 8, c.blocks[addr-1]);
+  c.blocks[addr] = 42;
+  assert_int_equal(0, memory_ctx_handle_realloc(&c, h, 8 * 4));
+  assert_int_equal(42, c.blocks[memory_ctx_resolve(&c, h)]);
+  memory_ctx_handle_free(&c, h);
+  assert_int_equal(4 * DEFAULT_SIZE, c.available_blocks);
+
+  // an area cached for b, moved while the cache works on c
+  int d = memory_ctx_lifelike_malloc(&c, 8);
+  assert_ptr_equal(&c, cache.ctx);
+  b.blocks[a] = 43;
+  a = memory_ctx_lifelike_realloc(&b, a, 8 * 4);
+  assert_ptr_equal(&c, cache.ctx);
+  assert_int_equal(43, b.blocks[a]);
+  assert_int_equal(5 * 8, b.blocks[a-1]);
+  memory_ctx_lifelike_free(&b, a);
+  memory_ctx_lifelike_free(&c, d);
+  memory_ctx_cache_flush(&b);
+  memory_ctx_cache_flush(&c);
+  assert_int_equal(4 * DEFAULT_SIZE, b.available_blocks);
+  assert_int_equal(4 * DEFAULT_SIZE, c.available_blocks);
+  memory_ctx_destroy(&b);
+  memory_ctx_destroy(&c);
+}
+
+static int disable_cache(void **state) {
+  (void)state;
+  memory_cache_enable(0);
+  return 0;
+}
+
+static int enable_cache(void **state) {
+  (void)state;
+  memory_cache_enable(1);
+  return 0;
+}
+#endif
+
 int main(int argc, char**argv) {
+  if(argc > 1 && strcmp(argv[1], "bench") == 0) { // ./memory_alloc bench [trace]
+    memory_bench(argc > 2 ? argv[2] : NULL);
+    return 0;
+  }
   const struct CMUnitTest tests[] = {
     /* a few tests for exercise 1.
      *
@@ -673,13 +3916,23 @@ int main(int argc, char**argv) {
      * your own tests.
      */
     cmocka_unit_test(test_exo1_memory_init),
+    cmocka_unit_test(test_exo1_memory_init_large_heap),
+    cmocka_unit_test(test_exo1_memory_init_region),
+    cmocka_unit_test(test_exo1_memory_ctx_independent_heaps),
     cmocka_unit_test(test_exo1_nb_consecutive_blocks_at_beginning_linked_list),
     cmocka_unit_test(test_exo1_nb_consecutive_blocks_at_middle_linked_list),
     cmocka_unit_test(test_exo1_nb_consecutive_blocks_at_end_linked_list),
+    cmocka_unit_test(test_exo1_nb_consecutive_blocks_extents),
     cmocka_unit_test(test_exo1_memory_allocate_beginning_linked_list),
     cmocka_unit_test(test_exo1_memory_allocate_middle_linked_list),
     cmocka_unit_test(test_exo1_memory_allocate_too_many_blocks),
+    cmocka_unit_test(test_exo1_memory_allocate_longer_than_runs),
     cmocka_unit_test(test_exo1_memory_free),
+    cmocka_unit_test(test_exo1_memory_buddy_split_merge),
+    cmocka_unit_test(test_exo1_memory_bitmap_runs),
+    cmocka_unit_test(test_exo1_memory_allocate_best_fit),
+    cmocka_unit_test(test_exo1_memory_allocate_next_fit),
+    cmocka_unit_test(test_exo1_memory_allocate_custom_policy),
 
     /* Run a few tests for exercise 2.
      *
@@ -689,6 +3942,7 @@ int main(int argc, char**argv) {
      */
 
     cmocka_unit_test(test_exo2_memory_reorder),
+    cmocka_unit_test(test_exo2_memory_lazy_reorder),
     cmocka_unit_test(test_exo2_memory_reorder_leading_to_successful_memory_allocate),
     cmocka_unit_test(test_exo2_memory_reorder_leading_to_failed_memory_allocate),
 
@@ -705,9 +3959,41 @@ int main(int argc, char**argv) {
     cmocka_unit_test(test_exo3_memory_realloc_lifelike_new_size_inf),
     cmocka_unit_test(test_exo3_memory_realloc_lifelike_size_null),
     cmocka_unit_test(test_exo3_memory_realloc_lifelike_addr_null_block),
+    cmocka_unit_test(test_exo3_memory_free_keeps_address_order),
     cmocka_unit_test(test_exo3_memory_realloc_lifelike_old_area_free),
+    cmocka_unit_test(test_exo3_memory_realloc_lifelike_coalesce_left),
+    cmocka_unit_test(test_exo3_memory_lifelike_malloc_size_class),
+    cmocka_unit_test(test_exo3_memory_buddy_lifelike),
+    cmocka_unit_test(test_exo3_memory_bitmap_lifelike),
+    cmocka_unit_test(test_exo3_memory_tlsf_lifelike),
+    cmocka_unit_test(test_exo3_memory_lifelike_engines),
+    cmocka_unit_test(test_exo3_memory_pack),
+    cmocka_unit_test(test_exo3_memory_handles),
+    cmocka_unit_test(test_exo3_memory_handles_chunks),
+    cmocka_unit_test(test_exo3_memory_defrag_step),
+    cmocka_unit_test(test_exo3_memory_defrag_step_budget),
+    cmocka_unit_test(test_exo3_memory_defrag_step_bitmap_run),
+    cmocka_unit_test(test_exo1_memory_pool),
+    cmocka_unit_test(test_exo1_memory_arenas),
+    cmocka_unit_test(test_exo1_memory_arenas_failed_init),
+    cmocka_unit_test(test_exo3_memory_remote_free),
+    cmocka_unit_test(test_exo1_memory_lifelike_malloc_batch),
+    cmocka_unit_test(test_exo2_memory_lifelike_free_bulk),
+    cmocka_unit_test(test_exo1_memory_allocate_nozero),
+    cmocka_unit_test(test_exo3_memory_buddy_shrink_not_zero),
     cmocka_unit_test(test_exo3_memory_realloc_lifelike_not_enough_memory)
 
   };
+#ifdef MEMORY_THREAD_SAFE
+  const struct CMUnitTest cache_tests[] = {
+    cmocka_unit_test(test_exo3_memory_thread_cache),
+    cmocka_unit_test(test_exo3_memory_cached_areas),
+    cmocka_unit_test(test_exo3_memory_cache_two_heaps)
+  };
+  // the tests above check exact layouts, which the thread caches change
+  int failed = cmocka_run_group_tests(tests, disable_cache, enable_cache);
+  return failed + cmocka_run_group_tests(cache_tests, NULL, NULL);
+#else
   return cmocka_run_group_tests(tests, NULL, NULL);
+#endif
 }
@@ -3,13 +3,22 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#ifdef MEMORY_THREAD_SAFE
+#include <pthread.h>
+#endif
 
 /* a block that does not exists */
 #define NULL_BLOCK INT32_MAX
 
-/* number of blocks */
+/* default number of blocks */
 #define DEFAULT_SIZE 16
 
+/* a heap cannot hold more blocks than the largest valid block index */
+#define MAX_SIZE ((size_t)NULL_BLOCK)
+
+/* size of a cache line. Two heaps never share one */
+#define MEMORY_CACHE_LINE 64
+
 /* a memory page is 8 bytes (64 bits) */
 typedef int64_t memory_page_t;
 
@@ -20,30 +29,563 @@ enum memory_errno {
   E_SHOULD_PACK,		/* error: not enough consecutive blocks */
 };
 
+/* number of levels of a bitmap: 64^6 bits cover MAX_SIZE blocks */
+#define MEMORY_BITMAP_LEVELS 6
+
+/* a bitmap with one bit per block. A bit of level i+1 is set when the
+ * matching word of level i is not zero, so that the nearest set bit
+ * is found with a few word operations.
+ */
+struct memory_bitmap {
+  uint64_t *words[MEMORY_BITMAP_LEVELS];
+  size_t nb_bits[MEMORY_BITMAP_LEVELS];
+  int nb_levels;
+};
+
+/* engines managing the available blocks of a heap */
+enum memory_engine {
+  MEMORY_LIST,			/* address-ordered list of available blocks */
+  MEMORY_BUDDY,			/* binary buddy system */
+  MEMORY_BITMAP,		/* runs of available blocks in free_map */
+  MEMORY_TLSF,			/* two-level segregated fit */
+};
+
+/* placement of the areas by the list engine */
+enum memory_placement {
+  MEMORY_FIRST_FIT,		/* lowest address that fits */
+  MEMORY_NEXT_FIT,		/* first fit from the last placement */
+  MEMORY_BEST_FIT,		/* smallest extent that fits */
+  MEMORY_WORST_FIT,		/* largest extent */
+  MEMORY_SIZE_CLASS,		/* first non-empty size class that fits */
+};
+
+struct memory_alloc_t;
+
+/* a placement policy of the list engine. find returns the head of an
+ * extent of at least block_nb blocks in the sorted list of ctx (see
+ * extent_len), NULL_BLOCK if there is none. find_lifelike does the same
+ * for memory_lifelike_malloc(). indexed is non-zero if the policy reads
+ * the treap of ctx, which is then maintained.
+ */
+struct memory_policy {
+  int (*find)(struct memory_alloc_t *ctx, size_t block_nb);
+  int (*find_lifelike)(struct memory_alloc_t *ctx, size_t block_nb);
+  int indexed;
+};
+
+/* the policies of the placements. Building with
+ * -DMEMORY_POLICY=memory_best_fit_policy (for instance) uses one of them
+ * for every heap, without indirect calls.
+ */
+extern const struct memory_policy memory_first_fit_policy;
+extern const struct memory_policy memory_next_fit_policy;
+extern const struct memory_policy memory_best_fit_policy;
+extern const struct memory_policy memory_worst_fit_policy;
+extern const struct memory_policy memory_size_class_policy;
+
+/* options of a heap, chosen when it is initialized. policy, if not
+ * NULL, replaces the policy of placement.
+ */
+struct memory_options {
+  enum memory_engine engine;
+  enum memory_placement placement;
+  const struct memory_policy *policy;
+};
+
+/* extents of up to MEMORY_EXACT_CLASSES blocks have one size class per
+ * length, larger extents one size class per power of two
+ */
+#define MEMORY_EXACT_CLASSES 16
+#define MEMORY_NB_CLASSES 64
+
+/* an unsorted list is reordered once the blocks freed since it became
+ * unsorted reach 1/MEMORY_REORDER_RATIO of the available blocks
+ */
+#define MEMORY_REORDER_RATIO 4
+
+/* when built with -DMEMORY_THREAD_SAFE, each thread keeps up to
+ * MEMORY_CACHE_SIZE freed lifelike areas of each length up to
+ * MEMORY_CACHE_CLASSES blocks, and refills or flushes half of them at
+ * once from the heap
+ */
+#define MEMORY_CACHE_CLASSES 16
+#define MEMORY_CACHE_SIZE 32
+
+/* the TLSF engine splits each power of two (first level) in
+ * MEMORY_TLSF_SL ranges of the same width (second level)
+ */
+#define MEMORY_TLSF_SL_LOG 3
+#define MEMORY_TLSF_SL (1 << MEMORY_TLSF_SL_LOG)
+#define MEMORY_TLSF_FL 32
+
+/* the handle table grows by chunks of MEMORY_HANDLE_CHUNK handles,
+ * which never move once allocated
+ */
+#define MEMORY_HANDLE_CHUNK 256
+
 struct memory_alloc_t {
   /* blocks that can be allocated */
-  memory_page_t blocks[DEFAULT_SIZE];
+  _Alignas(MEMORY_CACHE_LINE) memory_page_t *blocks;
+
+  /* number of blocks in the heap */
+  size_t nb_blocks;
 
   /* number of blocks that are available */
   size_t available_blocks;
 
-  /* index of the first available block */
+  /* index of the first available block (list engine only) */
   int first_block;
 
   /* error of the last memory operation. to be updated during each
    * call to memory_free/memory_alloc/memory_init
    */
   enum memory_errno error_no;
+
+  /* non-zero if blocks was allocated by memory_ctx_init() */
+  int owns_blocks;
+
+  /* bit i is set when block i is available */
+  struct memory_bitmap free_map;
+
+  /* bit i is set when block i is the header of a lifelike area, which
+   * memory_pack() may move
+   */
+  struct memory_bitmap header_map;
+
+  /* bit i is set when available block i is known to hold zeros: it was
+   * not given out since the heap was allocated by memory_ctx_init().
+   * The list engine writes its links in the available blocks, so it
+   * never sets them.
+   */
+  struct memory_bitmap zero_map;
+
+  /* engine managing the available blocks. The buddy engine does not
+   * link the available blocks through ctx->blocks: its free blocks are
+   * the extents of the size classes below, each one a power of two
+   * blocks aligned on its size. The bitmap engine only uses free_map.
+   * The TLSF engine keeps its extents in the lists of tlsf_head.
+   */
+  enum memory_engine engine;
+
+  /* placement policy of the list engine. The indexed policies (best fit
+   * and worst fit) also find the extents of the sorted list in a treap
+   * ordered by length then address, rooted at tree_root: tree_left and
+   * tree_right are indexed by the head of an extent (NULL otherwise).
+   */
+  const struct memory_policy *policy;
+  int tree_root;
+  int *tree_left;
+  int *tree_right;
+
+  /* block following the last area placed, where next-fit resumes its
+   * search. It is an address rather than a node of the list, so that
+   * frees, merges and reorders never leave it dangling.
+   */
+  size_t cursor;
+
+  /* number of extents (or list nodes, treap nodes) inspected by the
+   * searches of the list engine, for the benchmarks
+   */
+  size_t nb_inspected;
+
+  /* upper bound of the length of the largest run of available blocks.
+   * Inserting an extent raises it, a failed search lowers it to the
+   * length requested minus one, so that the same request is then
+   * rejected in O(1). It is exact after a rebuild of the extents.
+   */
+  size_t largest_extent;
+
+  /* block from which the next memory_ctx_defrag_step() resumes */
+  size_t defrag_pos;
+
+  /* non-zero when the list of available blocks is sorted by address.
+   * Freed blocks are then inserted at their place in the list.
+   */
+  int sorted;
+
+  /* number of blocks freed at the head of the unsorted list since it
+   * was last sorted
+   */
+  size_t unsorted_frees;
+
+  /* when the list is sorted, the available blocks form extents: runs
+   * of consecutive blocks linked in order. The number of blocks of an
+   * extent is stored at its first and at its last block (boundary tags)
+   * so that a freed area finds the extents on both sides in O(1). The
+   * next extent starts at ctx->blocks[head + extent_len[head] - 1].
+   * The buddy and TLSF engines tag their free blocks the same way. It
+   * is NULL for the bitmap engine, which only reads free_map, like
+   * class_next and class_prev.
+   */
+  int *extent_len;
+
+  /* when the list is sorted, the extents are also linked by size class
+   * (doubly linked through class_next and class_prev, indexed by the
+   * head of the extent) so that memory_lifelike_malloc() picks a
+   * fitting extent without scanning. Bit k of class_map is set when
+   * the list of class k is not empty.
+   */
+  int class_head[MEMORY_NB_CLASSES];
+  uint64_t class_map;
+  int *class_next;
+  int *class_prev;
+
+  /* free lists of the TLSF engine, linked like the size classes. Bit f
+   * of tlsf_fl_map is set when a list of tlsf_head[f] is not empty, bit
+   * s of tlsf_sl_map[f] when tlsf_head[f][s] is not empty.
+   */
+  int tlsf_head[MEMORY_TLSF_FL][MEMORY_TLSF_SL];
+  uint32_t tlsf_fl_map;
+  uint32_t tlsf_sl_map[MEMORY_TLSF_FL];
+
+  /* handle table: handles[h / MEMORY_HANDLE_CHUNK][h % MEMORY_HANDLE_CHUNK]
+   * is the address of the lifelike area of handle h, or NULL_BLOCK if h
+   * is not in use. The directory of chunks, allocated with the first
+   * handle, has room for one handle per block and is never reallocated.
+   * nb_handles slots have been handed out, out of handles_capacity. The
+   * released handles are stacked in free_handles, to be reused first.
+   */
+  int **handles;
+  size_t nb_handles;
+  size_t handles_capacity;
+  int *free_handles;
+  size_t nb_free_handles;
+
+  /* area_handles[first] is the handle of the lifelike area starting at
+   * block first, if that handle refers to the area. Allocated with the
+   * first handle, so that a move updates its handle in O(1).
+   */
+  int *area_handles;
+
+  /* lifelike areas freed by memory_ctx_remote_free(), not yet given
+   * back: a stack linked through the upper 32 bits of their headers,
+   * pushed by any thread and emptied at once by the next allocation
+   */
+  int remote_frees;
+
+#ifdef MEMORY_THREAD_SAFE
+  /* taken by every function working on the heap, except the lifelike
+   * mallocs and frees served by the cache of the calling thread.
+   * Recursive, since these functions call each other.
+   */
+  pthread_mutex_t lock;
+#endif
 };
 
+/* the default heap, used by the functions that do not take a context */
 extern struct memory_alloc_t m;
 
-/* Initialize the memory_alloc_t structure */
-void memory_init();
+/*************************************************/
+/*          Functions working on a heap          */
+/*************************************************/
+
+/* Initialize ctx with a heap of nb_blocks blocks. On failure,
+ * ctx->error_no is set to E_NOMEM and the heap is empty.
+ */
+void memory_ctx_init(struct memory_alloc_t *ctx, size_t nb_blocks);
+
+/* Initialize ctx with the nb_blocks blocks of region. The region is
+ * provided by the caller and is not released by memory_ctx_destroy().
+ */
+void memory_ctx_init_region(struct memory_alloc_t *ctx, memory_page_t *region,
+			    size_t nb_blocks);
+
+/* Initialize ctx with the nb_blocks blocks of region, or with a heap
+ * allocated by the allocator if region is NULL, using options (the
+ * list engine with first-fit placement if options is NULL).
+ */
+void memory_ctx_init_with(struct memory_alloc_t *ctx, memory_page_t *region,
+			  size_t nb_blocks, const struct memory_options *options);
+
+/* Release the blocks allocated by memory_ctx_init() and the
+ * bookkeeping of ctx
+ */
+void memory_ctx_destroy(struct memory_alloc_t *ctx);
+
+/* Recompute the bookkeeping of ctx from its list of available blocks.
+ * To be called after ctx->blocks or ctx->first_block were modified
+ * directly. List engine only.
+ */
+void memory_ctx_sync(struct memory_alloc_t *ctx);
+
+/* return the number of consecutive blocks starting from first */
+int memory_ctx_nb_consecutive_blocks(struct memory_alloc_t *ctx, int first);
+
+/* Sort the list of available blocks by address, in O(n). List engine only */
+void memory_ctx_reorder(struct memory_alloc_t *ctx);
+
+/* Print the current status of ctx */
+void memory_ctx_print(struct memory_alloc_t *ctx);
+
+/* Allocate size consecutive bytes and return the index of the first
+ * memory block. The buddy engine rounds the number of blocks up to a
+ * power of two.
+ */
+int memory_ctx_allocate(struct memory_alloc_t *ctx, size_t size);
+
+/* Same as memory_ctx_allocate() without zeroing the blocks */
+int memory_ctx_allocate_nozero(struct memory_alloc_t *ctx, size_t size);
+
+/* Free the size bytes memory space starting at address addr */
+void memory_ctx_free(struct memory_alloc_t *ctx, int addr, size_t size);
+
+/* Initialize an allocated buffer with zeros */
+void memory_ctx_initialize_buffer(struct memory_alloc_t *ctx, int start_index,
+				  size_t size);
+
+/* Allocate size consecutive bytes and return the index of the first
+ * memory block available to be written. Note: Return NULL_BLOCK if
+ * not enough available memory blocks.
+ */
+int memory_ctx_lifelike_malloc(struct memory_alloc_t *ctx, size_t size);
+
+/* Same as memory_ctx_lifelike_malloc() without zeroing the area */
+int memory_ctx_lifelike_malloc_nozero(struct memory_alloc_t *ctx, size_t size);
+
+/* Allocate a lifelike area of nmemb elements of size bytes, zeroed.
+ * Note: Return NULL_BLOCK with E_NOMEM if nmemb * size overflows.
+ */
+int memory_ctx_lifelike_calloc(struct memory_alloc_t *ctx, size_t nmemb, size_t size);
+
+/* Free the memory blocks designated by addr, which value must have
+ * been previously returned by memory_ctx_lifelike_malloc().
+*/
+void memory_ctx_lifelike_free(struct memory_alloc_t *ctx, int addr);
+
+/* Allocate up to count lifelike areas of size bytes, as many calls to
+ * memory_ctx_lifelike_malloc() would, in a single pass over the
+ * available blocks. Their addresses are stored in out. Return how many
+ * were allocated; error_no is set when fewer than count.
+ */
+size_t memory_ctx_lifelike_malloc_batch(struct memory_alloc_t *ctx, size_t size,
+					size_t count, int *out);
+
+/* Free the n lifelike areas designated by addrs, as many calls to
+ * memory_ctx_lifelike_free() would. addrs is sorted in place, and the
+ * adjacent areas are given back together. The list of available blocks
+ * is left sorted.
+ */
+void memory_ctx_lifelike_free_bulk(struct memory_alloc_t *ctx, int *addrs, size_t n);
+
+/* Change the size of the memory block designated by addr to size  bytes.
+ * The  contents will be  unchanged  in the range from the start of the
+ * region up to the minimum of the old and new sizes.  If the new size
+ * is larger than the old size, the added memory will not be initialized.
+ * If addr is NULL_BLOCK, then the call is equivalent to
+ * memory_ctx_lifelike_malloc(size), for all values of size; if size is
+ * equal to zero, and addr is not NULL_BLOCK, then the call is equivalent
+ * to memory_ctx_lifelike_free(ptr). Unless addr is NULL_BLOCK, it must
+ * have been returned by an earlier call to memory_ctx_lifelike_malloc().
+ * The area grows in place when the available blocks around it are
+ * enough, possibly moving to the left. Otherwise, if the area pointed
+ * to was moved, a memory_ctx_lifelike_free(addr) is done.
+ * Note: Return NULL_BLOCK if not enough available memory blocks, addr
+ * is then left untouched.
+*/
+int memory_ctx_lifelike_realloc(struct memory_alloc_t *ctx, int addr, size_t size);
+
+/* a lifelike area moved by memory_ctx_pack() */
+struct memory_relocation {
+  int old_addr;
+  int new_addr;
+};
+
+/* Compact the heap: the lifelike areas are moved towards its start so
+ * that the available blocks form one run. The areas of
+ * memory_ctx_allocate() stay in place and split the runs. If
+ * relocations is not NULL, it is set to an array of the moved areas
+ * sorted by old address, to be released with free() (NULL if nothing
+ * moved), and nb_relocations to its length. Nothing moves with the
+ * buddy engine.
+ */
+void memory_ctx_pack(struct memory_alloc_t *ctx, struct memory_relocation **relocations,
+		     size_t *nb_relocations);
+
+/* Return the address of the area at addr after a memory_ctx_pack() that
+ * returned relocations
+ */
+int memory_relocated(const struct memory_relocation *relocations,
+		     size_t nb_relocations, int addr);
+
+/* progress of the defragmentation, reported by memory_ctx_defrag_step() */
+struct memory_defrag_stats {
+  size_t moved_blocks;		/* blocks moved by the step */
+  int done;			/* non-zero when there is nothing left to move */
+};
+
+/* Compact the heap like memory_ctx_pack(), doing at most budget units
+ * of work per call: a moved block or a skipped block of
+ * memory_ctx_allocate() costs one unit, and the reorder of an unsorted
+ * list, done first, costs its available blocks. Each call resumes where
+ * the previous one stopped, and starts over once the end of the heap is
+ * reached. An area longer than budget is moved alone, so that every
+ * call makes progress. relocations and nb_relocations are set like with
+ * memory_ctx_pack(), for the areas moved by this call. stats, if not
+ * NULL, is filled with the progress made.
+ */
+void memory_ctx_defrag_step(struct memory_alloc_t *ctx, size_t budget,
+			    struct memory_relocation **relocations, size_t *nb_relocations,
+			    struct memory_defrag_stats *stats);
+
+/* fragmentation of the available blocks */
+struct memory_fragmentation {
+  size_t largest_run;		/* blocks of the largest run of available blocks */
+  size_t nb_extents;		/* number of runs of available blocks */
+};
+
+/* Fill fragmentation by walking every run of available blocks of ctx */
+void memory_ctx_fragmentation(struct memory_alloc_t *ctx, struct memory_fragmentation *fragmentation);
+
+/* Allocate a lifelike area like memory_ctx_lifelike_malloc() and return
+ * a handle to it. Unlike its address, the handle stays valid when
+ * memory_ctx_pack() moves the area.
+ * Note: Return NULL_BLOCK if the area or the handle cannot be allocated.
+ */
+int memory_ctx_handle_malloc(struct memory_alloc_t *ctx, size_t size);
+
+/* Free the area of handle, which can then be reused */
+void memory_ctx_handle_free(struct memory_alloc_t *ctx, int handle);
+
+/* Resize the area of handle like memory_ctx_lifelike_realloc(). The
+ * handle is kept when the area moves.
+ * Note: Return NULL_BLOCK if not enough available memory blocks, or if
+ * size is zero (the handle is then released).
+ */
+int memory_ctx_handle_realloc(struct memory_alloc_t *ctx, int handle, size_t size);
+
+/* Return the current address of the area of handle.
+ * Note: No lock is taken. As the table never moves, a thread may resolve
+ * its handles while others allocate or free theirs, but not while
+ * memory_ctx_pack() or memory_ctx_defrag_step() may move the areas.
+ */
+static inline int memory_ctx_resolve(const struct memory_alloc_t *ctx, int handle) {
+  return ctx->handles[handle / MEMORY_HANDLE_CHUNK][handle % MEMORY_HANDLE_CHUNK];
+}
+
+/* a pool of slots of the same size, carved from a heap by
+ * memory_ctx_pool_init(). Its free slots form a Treiber stack, linked
+ * through the blocks like the list of available blocks. The lower 32
+ * bits of head hold the first free slot, the upper 32 bits a tag that
+ * every push and pop increments. A compare-and-swap on head thus fails
+ * if the slot it read was popped and pushed back meanwhile (ABA).
+ */
+struct memory_pool {
+  memory_page_t *blocks;
+  int first;			/* first block of the pool */
+  size_t slot_blocks;		/* number of blocks of a slot */
+  size_t nb_slots;
+  uint64_t head;
+};
+
+/* Take nb_slots slots of slot_size bytes from ctx for pool. On failure,
+ * ctx->error_no is set and the pool is empty.
+ */
+void memory_ctx_pool_init(struct memory_alloc_t *ctx, struct memory_pool *pool,
+			  size_t slot_size, size_t nb_slots);
+
+/* Give the blocks of pool back to ctx. Its slots must all be free. */
+void memory_ctx_pool_destroy(struct memory_alloc_t *ctx, struct memory_pool *pool);
+
+/* Return the first block of a free slot of pool, NULL_BLOCK if there is
+ * none. Lock-free: may be called from any thread without a mutex.
+ */
+int memory_pool_alloc(struct memory_pool *pool);
+
+/* Give the slot starting at addr back to pool. Lock-free. */
+void memory_pool_free(struct memory_pool *pool, int addr);
+
+/* Free the lifelike area at addr without taking the lock of ctx: the
+ * area is pushed on its remote frees with a compare-and-swap, to be
+ * freed by the next allocation (or pack) on ctx. For threads that
+ * free the areas of a heap they do not allocate from.
+ */
+void memory_ctx_remote_free(struct memory_alloc_t *ctx, int addr);
+
+/* a heap split in nb_arenas arenas, each one a heap with its own free
+ * structures (and its own lock when built with -DMEMORY_THREAD_SAFE)
+ * over a slice of blocks. The addresses are indices in blocks, so that
+ * the arena owning an address is found by a division. Each thread
+ * allocates from its home arena, assigned round-robin at its first
+ * allocation, and from the next arenas when it is full.
+ */
+struct memory_arenas {
+  memory_page_t *blocks;	/* the blocks of all the arenas */
+  struct memory_alloc_t *arenas;
+  size_t nb_arenas;
+  size_t arena_blocks;		/* blocks per arena, the last one gets the rest */
+};
+
+/* Split a heap of nb_blocks blocks in nb_arenas arenas initialized with
+ * options. On failure, the heap has no arena: the allocations return
+ * NULL_BLOCK and the frees do nothing.
+ */
+void memory_arenas_init(struct memory_arenas *arenas, size_t nb_arenas, size_t nb_blocks,
+			const struct memory_options *options);
+
+/* Release the blocks and the arenas */
+void memory_arenas_destroy(struct memory_arenas *arenas);
+
+/* Same as memory_ctx_allocate() on the arenas */
+int memory_arenas_allocate(struct memory_arenas *arenas, size_t size);
+
+/* Same as memory_ctx_free() on the arena owning addr */
+void memory_arenas_free(struct memory_arenas *arenas, int addr, size_t size);
+
+/* Same as memory_ctx_lifelike_malloc() on the arenas */
+int memory_arenas_lifelike_malloc(struct memory_arenas *arenas, size_t size);
+
+/* Same as memory_ctx_lifelike_free() on the arena owning addr. When it
+ * is not the home arena of the calling thread, memory_ctx_remote_free()
+ * is used.
+ */
+void memory_arenas_lifelike_free(struct memory_arenas *arenas, int addr);
+
+/* Give the areas cached by the calling thread back to ctx. To be called
+ * by each thread before ctx is destroyed. Does nothing unless built
+ * with -DMEMORY_THREAD_SAFE.
+ */
+void memory_ctx_cache_flush(struct memory_alloc_t *ctx);
+
+/* Turn the cache of the calling thread on (the default) or off. Turning
+ * it off flushes it, and the lifelike areas are then placed exactly as
+ * in a build without -DMEMORY_THREAD_SAFE.
+ */
+void memory_cache_enable(int enabled);
+
+/* Print a message corresponding to errno */
+void memory_error_print(enum memory_errno error_number);
+
+/*************************************************/
+/*     Same functions on the default heap m      */
+/*************************************************/
+
+/* Initialize the memory_alloc_t structure with a heap of nb_blocks
+ * blocks. On failure, m.error_no is set to E_NOMEM and the heap is empty.
+ */
+void memory_init(size_t nb_blocks);
+
+/* Initialize the memory_alloc_t structure with the nb_blocks blocks
+ * of region. The region is provided by the caller and is not released
+ * by memory_destroy().
+ */
+void memory_init_region(memory_page_t *region, size_t nb_blocks);
+
+/* Same as memory_ctx_init_with() on the default heap m */
+void memory_init_with(memory_page_t *region, size_t nb_blocks,
+		      const struct memory_options *options);
+
+/* Release the blocks allocated by memory_init() */
+void memory_destroy();
+
+/* Recompute the bookkeeping of m from its list of available blocks */
+void memory_sync();
 
 /* return the number of consecutive blocks starting from first */
 int nb_consecutive_blocks(int first);
 
+/* Sort the list of available blocks by address */
+void memory_reorder();
+
 /* Print the current status of the memory_alloc_t structure */
 void memory_print();
 
@@ -52,12 +594,12 @@ void memory_print();
  */
 int memory_allocate(size_t size);
 
+/* Same as memory_ctx_allocate_nozero() on the default heap m */
+int memory_allocate_nozero(size_t size);
+
 /* Free the size bytes memory space starting at address addr */
 void memory_free(int addr, size_t size);
 
-/* Print a message corresponding to errno */
-void memory_error_print(enum memory_errno error_number);
-
 /* Initialize an allocated buffer with zeros */
 void initialize_buffer(int start_index, size_t size);
 
@@ -67,23 +609,57 @@ void initialize_buffer(int start_index, size_t size);
  */
 int memory_lifelike_malloc(size_t size);
 
-/* Free the memory blocks designated by addr, which value must have 
+/* Same as memory_ctx_lifelike_malloc_nozero() on the default heap m */
+int memory_lifelike_malloc_nozero(size_t size);
+
+/* Same as memory_ctx_lifelike_calloc() on the default heap m */
+int memory_lifelike_calloc(size_t nmemb, size_t size);
+
+/* Free the memory blocks designated by addr, which value must have
  * been previously returned by memory_lifelike_malloc().
 */
 void memory_lifelike_free(int addr);
 
-/* Change the size of the memory block designated by addr to size  bytes.
- * The  contents will be  unchanged  in the range from the start of the 
- * region up to the minimum of the old and new sizes.  If the new size 
- * is larger than the old size, the added memory will not be initialized.
- * If addr is NULL_BLOCK, then the call is equivalent to
- * memory_lifelike_malloc(size), for all values of size; if size is equal
- * to zero, and addr is not NULL_BLOCK, then the call is equivalent to 
- * memory_lifelike_free(ptr). Unless addr is NULL_BLOCK, it must have 
- * been returned by an earlier call to memory_lifelike_malloc(). 
- * If the area pointed to was moved, a memory_lifelike_free(addr) is done.
- * Note: Return NULL_BLOCK if not enough available memory blocks.
-*/
+/* Same as memory_ctx_lifelike_malloc_batch() on the default heap m */
+size_t memory_lifelike_malloc_batch(size_t size, size_t count, int *out);
+
+/* Same as memory_ctx_lifelike_free_bulk() on the default heap m */
+void memory_lifelike_free_bulk(int *addrs, size_t n);
+
+/* Same as memory_ctx_lifelike_realloc() on the default heap m */
 int memory_lifelike_realloc(int addr, size_t size);
 
+/* Same as memory_ctx_pack() on the default heap m */
+void memory_pack(struct memory_relocation **relocations, size_t *nb_relocations);
+
+/* Same as memory_ctx_defrag_step() on the default heap m */
+void memory_defrag_step(size_t budget, struct memory_relocation **relocations,
+			size_t *nb_relocations, struct memory_defrag_stats *stats);
+
+/* Same as memory_ctx_fragmentation() on the default heap m */
+void memory_fragmentation(struct memory_fragmentation *fragmentation);
+
+/* Same as memory_ctx_cache_flush() on the default heap m */
+void memory_cache_flush();
+
+/* Same as memory_ctx_pool_init() on the default heap m */
+void memory_pool_init(struct memory_pool *pool, size_t slot_size, size_t nb_slots);
+
+/* Same as memory_ctx_pool_destroy() on the default heap m */
+void memory_pool_destroy(struct memory_pool *pool);
+
+/* Same as memory_ctx_handle_malloc() on the default heap m */
+int memory_handle_malloc(size_t size);
+
+/* Same as memory_ctx_handle_free() on the default heap m */
+void memory_handle_free(int handle);
+
+/* Same as memory_ctx_handle_realloc() on the default heap m */
+int memory_handle_realloc(int handle, size_t size);
+
+/* Same as memory_ctx_resolve() on the default heap m */
+static inline int memory_resolve(int handle) {
+  return memory_ctx_resolve(&m, handle);
+}
+
 #endif	/* MEMORY_ALLOC_H */